@@ -16,6 +16,8 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
 
 #include <stdio.h>
 
@@ -33,20 +35,39 @@
     if (pointer != null) \
         free(pointer);
 
-#define raise(errnum, val)                    \
+// Reports the error `errnum` and returns `val`. The pending output of
+// the state `A` is written first, so diagnostics show up in the order
+// they happened. A null `A` writes nothing, like in `Alu_flush` itself.
+#define raise(A, errnum, val)                 \
     {                                         \
+        if ((A) != null)                      \
+            Alu_flush(A);                     \
         printf("[ERROR] in %s (%s:%d) %d \n", \
                __FUNCTION__,                  \
                __FILE__, __LINE__,            \
                errnum);                       \
+        fflush(stdout);                       \
         return val;                           \
     }                                         \
     while (0)                                 \
         ;
 
-#define debug(A, msg, ...) \
-    if (A->verbose)        \
-    printf(msg, ##__VA_ARGS__)
+#define debug(A, msg, ...)                                 \
+    if (A->verbose)                                        \
+    (Alu_flush(A), printf(msg, ##__VA_ARGS__), fflush(stdout))
+
+// Address of stack[index].
+#define ALU_STACK_SLOT(A, index) \
+    (&(A)->stack.slots[((A)->stack.head + (index)) & ((A)->stack.cap - 1)])
+
+// Whether the variable `var` holds a number, an integer or a double.
+#define ALU_ISNUMBER(var) \
+    (((var)->type == ALU_NUMBER) or ((var)->type == ALU_INTEGER))
+
+// The number in the variable `var` as a double.
+#define ALU_TONUMBER(var)                                   \
+    ((var)->type == ALU_INTEGER ? (alu_Number)(var)->as.integer \
+                                : (var)->as.number)
 
 #define ALU_VER_MAJ 0
 #define ALU_VER_MIN 2
@@ -54,6 +75,93 @@
 
 #define ALU_SIGNATURE "\x1b\xca\xca"
 
+// Sectioned bytecode, made of a header, a constant pool, a chunk table
+// and the code of the chunks. Numbers are 4 bytes big endian.
+//
+//     signature, ALU_FORMAT_MARK, format (2), byte order (0), 2 bytes of flags
+//     ALU_VER_NUM, constants, chunks, max stack depth, registers, instructions
+//     constants times: length, characters
+//     chunks times: code offset, code length
+//     code
+//
+// The last chunk is the entry point, like in `spec/`. String operands
+// are indices in the constant pool. With `ALU_FLAG_VARINT`, register,
+// constant and jump operands and `OP_PUSHINT` immediates are LEB128
+// varints, zigzag encoded when signed. The v1 bytecode is the signature
+// followed by the instructions.
+#define ALU_FORMAT_MARK 0xff
+#define ALU_FORMAT_V2 2
+#define ALU_HEADER_SIZE 32
+#define ALU_FLAG_VARINT 0x0001
+
+// Highest register index a program may use.
+#define ALU_MAX_REGISTER 0xffff
+
+// Default size of an arena chunk.
+#define ALU_ARENA_CHUNK 4096
+
+// Strings up to `32 << (ALU_STRING_CLASSES - 1)` bytes are recycled.
+#define ALU_STRING_CLASSES 4
+
+// Concatenations longer than this build a rope instead of copying.
+#define ALU_ROPE_MIN 64
+
+// Size of a buffer big enough for any number written by `Alu_numtostr`.
+#define ALU_NUMBER_BUFSIZE 32
+
+// Size of a buffer big enough for any pointer written by `__Alu_ptrtostr`.
+#define ALU_POINTER_BUFSIZE (sizeof(uintptr_t) * 2 + 2)
+
+// Size of the output buffer, it is written once full.
+#define ALU_OUTPUT_BUFSIZE 65536
+
+// Size of the reads of the streaming loader.
+#define ALU_STREAM_CHUNK 65536
+
+// Integers stay within the range where doubles are exact, so that one
+// always holds the same value as the double it stands for. A result out
+// of it is a double.
+#define ALU_INTEGER_MAX (((alu_Integer)1 << 53) - 1)
+
+// Stack depth of a program the verifier could not bound.
+#define ALU_DEPTH_UNBOUNDED ((alu_Size)-1)
+
+// Times the verifier lets the depth of a block grow before it
+// considers it unbounded, a loop pushing more than it pops.
+#define ALU_VERIFY_WIDEN 8
+
+// Load time peephole optimizer, build with `-DALU_NO_OPTIMIZE` to run
+// the bytecode as it is fed.
+#if defined(ALU_NO_OPTIMIZE)
+#define ALU_OPTIMIZE 0
+#else
+#define ALU_OPTIMIZE 1
+#endif
+
+// Superinstructions the optimizer fuses, see `A->fuse`.
+#define ALU_FUSE_CALLDEF 0x1
+#define ALU_FUSE_ADDREG 0x2
+#define ALU_FUSE_EVALJFA 0x4
+#define ALU_FUSE_EVALJTR 0x8
+#if not defined(ALU_FUSE_DEFAULT)
+#define ALU_FUSE_DEFAULT (ALU_FUSE_CALLDEF | ALU_FUSE_ADDREG | \
+                          ALU_FUSE_EVALJFA | ALU_FUSE_EVALJTR)
+#endif
+
+// Counts the executed instructions by opcode, build with
+// `-DALU_PROFILE` to print them when the state is closed.
+#if not defined(ALU_PROFILE)
+#define ALU_PROFILE 0
+#endif
+
+// Computed goto dispatch, build with `-DALU_NO_THREADED` to use the
+// portable switch instead.
+#if defined(__GNUC__) and not defined(ALU_NO_THREADED)
+#define ALU_THREADED 1
+#else
+#define ALU_THREADED 0
+#endif
+
 /**
  *
  * @category Typedefs
@@ -62,6 +170,7 @@
 
 typedef uint8_t alu_Byte;
 typedef double alu_Number;
+typedef int64_t alu_Integer;
 typedef char *alu_String;
 typedef uint32_t alu_Size;
 
@@ -79,12 +188,14 @@ typedef enum
 
     AERR_CREAD, // C Invalid read.
     AERR_CSTAT, // C Stat failure.
+    AERR_CWRIT, // C Write failure.
 } alu_Errno;
 
 typedef enum
 {
     ALU_NULL = 0, // Nothing.
     ALU_NUMBER,   // A double.
+    ALU_INTEGER,  // A number without fraction, see `ALU_INTEGER_MAX`.
     ALU_STRING,   // An allocated pointer to a character array.
     ALU_BOOL,     // A value which is either true or false.
     ALU_ABSTRACT, // A non-allocated C pointer.
@@ -124,8 +235,25 @@ typedef enum
     OP_UNLOAD,
     OP_DEFUNLOAD,
 
+    // Compact
+    OP_PUSHINT, // Integer immediate, pushed as an `ALU_INTEGER`.
+
     // End
-    OP_END
+    OP_END,
+
+    // Internal, never found in bytecode
+    OP_YIELD = OP_END, // End of the code decoded so far.
+    OP_CALLDEF,        // `OP_PUSHDEF`, `OP_SUPER`, `OP_CALL`.
+    OP_ADDREG,         // `OP_UNLOAD`, `OP_PUSHNUM`, `OP_SUMSTACK`, `OP_LOAD`.
+    OP_EVALJFA,        // `OP_EVAL`, `OP_JFA`.
+    OP_EVALJTR,        // `OP_EVAL`, `OP_JTR`.
+    OP_SUMNUM,         // `OP_SUMSTACK` of two numbers.
+    OP_SUMSTR,         // `OP_SUMSTACK` of two strings.
+    OP_EVALNUM,        // `OP_EVAL` of two numbers.
+    OP_EVALSTR,        // `OP_EVAL` of two strings.
+    OP_SUMINT,         // `OP_SUMSTACK` of two integers.
+    OP_EVALINT,        // `OP_EVAL` of two integers.
+    OP_COUNT
 } alu_Opcode;
 
 typedef enum
@@ -135,47 +263,156 @@ typedef enum
     EVAL_GREATER = (1 << 2)
 } alu_Eval;
 
+typedef enum
+{
+    ALU_STR_CONST = (1 << 0), // Lives in the constant pool, never freed.
+    ALU_STR_ROPE = (1 << 1),  // Concatenation of two strings.
+} alu_StringFlag;
+
+// Immutable string shared by reference counting.
+//
+// A rope holds its left and right strings in place of its characters.
+// The right one is always flat, and once the rope is flattened its left
+// one is the flat result and its right one is null.
+typedef struct
+{
+    alu_Size refs;
+    alu_Size len;
+    alu_Size hash;
+    alu_Size flags;
+    char chars[];
+} alu_StringObject;
+
+#define ALU_ROPE_LEFT(str) (((alu_StringObject **)(str)->chars)[0])
+#define ALU_ROPE_RIGHT(str) (((alu_StringObject **)(str)->chars)[1])
+
+// Open addressing set of the interned string constants.
+typedef struct
+{
+    alu_StringObject **slots;
+    alu_Size len;
+    alu_Size cap;
+} alu_Pool;
+
+// A value, only strings own heap memory.
 typedef struct
 {
-    void *data;
     alu_Type type;
+    union
+    {
+        alu_Number number;
+        alu_Integer integer;
+        _Bool boolean;
+        void *abstract;
+        alu_StringObject *string;
+    } as;
 } alu_Variable;
 
-typedef struct s_stack2
+// Growable ring buffer of variables, `cap` is always a power of two.
+// Index 0 is the head of the stack, pushes go after the last element.
+typedef struct
+{
+    alu_Variable *slots;
+    alu_Size head;
+    alu_Size len;
+    alu_Size cap;
+} alu_VarStack;
+
+typedef struct
+{
+    alu_Byte op;
+    union
+    {
+        alu_Size size;
+        alu_Number number;
+        alu_Integer integer;
+        alu_StringObject *string;
+        alu_Byte byte;
+        int offset;
+        alu_Size target;
+    } arg;
+} alu_Instruction;
+
+// Chunk of memory freed all at once with its `alu_State`.
+typedef struct s_arena
+{
+    struct s_arena *next;
+    size_t used;
+    size_t size;
+    max_align_t data[];
+} alu_Arena;
+
+// Range of stack depths a basic block can be entered with.
+typedef struct
+{
+    alu_Size lo;
+    alu_Size hi;
+    alu_Byte grown;
+    _Bool seen;
+    _Bool queued;
+} alu_Depth;
+
+// Basic blocks of the code. `starts` is sorted, `marks` has a bit set at
+// each start and `rank` counts the bits set before each word of `marks`.
+// `loops` counts the backward jumps.
+typedef struct
+{
+    alu_Size *starts;
+    alu_Size count;
+    uint64_t *marks;
+    alu_Size *rank;
+    alu_Depth *depths;
+    alu_Size loops;
+} alu_Blocks;
+
+// Buffered output of the alu functions.
+// A negative `fd` keeps everything in memory for the embedder.
+typedef struct
 {
-    void *data;
-    struct s_stack2 *next;
-    struct s_stack2 *previous;
-    struct s_stack2 *top;
-} alu_Stack;
+    char *buf;
+    size_t len;
+    size_t cap;
+    int fd;
+} alu_Output;
 
 typedef struct
 {
     alu_String error;
-    alu_Stack *stack;
-    alu_Stack *garbage;
-    alu_Stack *regs;
-    alu_Stack *instructions;
+    alu_Arena *arena;
+    void *freestrings[ALU_STRING_CLASSES];
+    alu_Pool constants;
+    alu_VarStack stack;
+    alu_Variable *regs;
+    alu_Size nregs;
+    alu_Instruction *code;
+    alu_Size codelen;
+    alu_Size codecap;
+    alu_Size njumps;
+    long farthest;
+    alu_Size pc;
+    _Bool streaming;
+    alu_StringObject **consts;
+    alu_Size nconsts;
+    _Bool varint;
+    alu_Size *chunks;
+    alu_Size nchunks;
+    alu_Size chunkstart;
+    _Bool verified;
+    alu_Size maxdepth;
+    alu_Size fuse;
+#if ALU_PROFILE
+    uint64_t profile[OP_COUNT];
+#endif
+    alu_Output out;
 
     alu_Size seed;
     _Bool verbose;
 } alu_State;
 
-typedef struct
-{
-    alu_Size index;
-    alu_Variable *var;
-} alu_Register;
-
-typedef void (*func0_t)(void *A);                   // 0
-typedef void (*func1_t)(void *A, alu_Size);         // 1
-typedef void (*func2_t)(void *A, alu_Number);       // 2
-typedef void (*func3_t)(void *A, const alu_String); // 3
-typedef void (*func4_t)(void *A, alu_Byte);         // 4
+typedef void (*func0_t)(void *A);
 
 typedef struct
 {
-    void *func;
     alu_Byte argument;
 } alu_StructOpcode;
 
@@ -197,40 +434,90 @@ void Alu_stackclose(alu_State *A);
 void Alu_sumstack(alu_State *A);
 void Alu_load(alu_State *A, alu_Size);
 void Alu_unload(alu_State *A, alu_Size);
+void Alu_defunload(alu_State *A, alu_Size);
 void Alu_wait(alu_State *A, alu_Size);
 void Alu_pushnumber(alu_State *A, alu_Number);
+void Alu_pushinteger(alu_State *A, alu_Integer);
 void Alu_pushstring(alu_State *A, const alu_String);
 void Alu_pushbool(alu_State *A, _Bool);
 void Alu_eval(alu_State *A, alu_Byte);
 void Alu_pushdef(alu_State *A, alu_String str);
 void Alu_call(alu_State *A);
 void Alu_super(alu_State *A);
+void __Alu_call(alu_State *A);
+void __Alu_super(alu_State *A);
+void __Alu_eval(alu_State *A, alu_Byte);
+_Bool __Alu_compare(alu_State *A, alu_Byte);
+
+/* Output */
+
+void Alu_flush(alu_State *A);
+
+static const alu_StructOpcode F[OP_END] = {
+    [OP_HALT] = {0},
+    [OP_STACKCLOSE] = {0},
+    [OP_SUMSTACK] = {0},
+    [OP_CALL] = {0},
+    [OP_SUPER] = {0},
+    [OP_LOAD] = {1},
+    [OP_UNLOAD] = {1},
+    [OP_DEFUNLOAD] = {1},
+    [OP_PUSHNUM] = {2},
+    [OP_PUSHSTR] = {3},
+    [OP_PUSHDEF] = {3},
+    [OP_PUSHBOOL] = {4},
+    [OP_EVAL] = {4},
+    [OP_PUSHINT] = {5},
+};
 
-static const alu_StructOpcode F[] = {
-    [OP_HALT] = {null, 0},
-    [OP_STACKCLOSE] = {Alu_stackclose, 0},
-    [OP_SUMSTACK] = {Alu_sumstack, 0},
-    [OP_CALL] = {Alu_call, 0},
-    [OP_SUPER] = {Alu_super, 0},
-    [OP_LOAD] = {Alu_load, 1},
-    [OP_UNLOAD] = {Alu_unload, 1},
-    [OP_PUSHNUM] = {Alu_pushnumber, 2},
-    [OP_PUSHSTR] = {Alu_pushstring, 3},
-    [OP_PUSHDEF] = {Alu_pushdef, 3},
-    [OP_PUSHBOOL] = {Alu_pushbool, 4},
-    [OP_EVAL] = {Alu_eval, 4},
+#if ALU_PROFILE
+static const alu_String OPNAMES[OP_COUNT] = {
+    [OP_HALT] = "HALT",
+    [OP_RET] = "RET",
+    [OP_JMP] = "JMP",
+    [OP_JTR] = "JTR",
+    [OP_JFA] = "JFA",
+    [OP_JEM] = "JEM",
+    [OP_JNEM] = "JNEM",
+    [OP_PUSHNUM] = "PUSHNUM",
+    [OP_PUSHSTR] = "PUSHSTR",
+    [OP_PUSHBOOL] = "PUSHBOOL",
+    [OP_PUSHDEF] = "PUSHDEF",
+    [OP_SUMSTACK] = "SUMSTACK",
+    [OP_STACKCLOSE] = "STACKCLOSE",
+    [OP_EVAL] = "EVAL",
+    [OP_SUPER] = "SUPER",
+    [OP_CALL] = "CALL",
+    [OP_LOAD] = "LOAD",
+    [OP_UNLOAD] = "UNLOAD",
+    [OP_DEFUNLOAD] = "DEFUNLOAD",
+    [OP_PUSHINT] = "PUSHINT",
+    [OP_YIELD] = "YIELD",
+    [OP_CALLDEF] = "CALLDEF",
+    [OP_ADDREG] = "ADDREG",
+    [OP_EVALJFA] = "EVALJFA",
+    [OP_EVALJTR] = "EVALJTR",
+    [OP_SUMNUM] = "SUMNUM",
+    [OP_SUMSTR] = "SUMSTR",
+    [OP_EVALNUM] = "EVALNUM",
+    [OP_EVALSTR] = "EVALSTR",
+    [OP_SUMINT] = "SUMINT",
+    [OP_EVALINT] = "EVALINT",
 };
+#endif
 
 /* String Conversion Functions */
 
-void __Alu_btoa(alu_Variable *var);
-void __Alu_nulltoa(alu_Variable *var);
-void __Alu_ntoa(alu_Variable *var);
-void __Alu_abstracttoa(alu_Variable *var);
+void __Alu_btoa(alu_State *A, alu_Variable *var);
+void __Alu_nulltoa(alu_State *A, alu_Variable *var);
+void __Alu_ntoa(alu_State *A, alu_Variable *var);
+void __Alu_itoa(alu_State *A, alu_Variable *var);
+void __Alu_abstracttoa(alu_State *A, alu_Variable *var);
 
 static const void *CONVERT_STRING[] = {
     [ALU_NULL] = __Alu_nulltoa,
     [ALU_NUMBER] = __Alu_ntoa,
+    [ALU_INTEGER] = __Alu_itoa,
     [ALU_STRING] = null,
     [ALU_BOOL] = __Alu_btoa,
     [ALU_ABSTRACT] = __Alu_abstracttoa,
@@ -253,31 +540,14 @@ static const alu_Def DEF[] = {
  *
  */
 
-// Cuts a string from `from` to `to`.
-char *strcut(const char *str, size_t from, size_t to)
-{
-    size_t size = to - from;
-    char *buf = (char *)malloc((size + 1) * sizeof(char));
-    if (buf == null)
-        raise(AERR_NOMEM, null);
-    memset(buf, 0, size + 1);
-    if (buf == null)
-        return null;
-    // for (size_t n = 0; str[n + from] != '\0' and n < size; ++n)
-    for (size_t n = 0; n < size; ++n)
-        buf[n] = str[n + from];
-    buf[size] = '\0';
-    return buf;
-}
-
 /// Reads the int value from a byte array.
 /// `00 00 0c 7a -> (int) 3194`
 int bytesint(const alu_Byte *bytes)
 {
-    int result = 0;
+    uint32_t result = 0;
     for (unsigned short i = 0; i < sizeof(int); ++i)
         result = (result << 8) | bytes[i];
-    return result;
+    return (int)result;
 }
 
 /// Reads the double value from a byte array.
@@ -295,63 +565,37 @@ double bytesdouble(const unsigned char *bytes)
     return value.d;
 }
 
-void strrev(char *str)
+/// Reads an unsigned LEB128 varint of at most 32 bits in `value`.
+/// Returns its length, or 0 if it doesn't fit.
+/// `ac 02 -> (uint32_t) 300`
+size_t bytesuleb(const alu_Byte *bytes, uint32_t *value)
 {
-    char swap = '\0';
-    for (size_t a = 0, b = strlen(str) - 1; a < b; ++a, --b)
+    uint32_t result = 0;
+    size_t n = 0;
+    if (bytes[0] < 0x80)
     {
-        swap = str[a];
-        str[a] = str[b];
-        str[b] = swap;
+        *value = bytes[0];
+        return 1;
     }
+    do
+    {
+        if ((n == 4) and (bytes[n] > 0x0f))
+            return 0;
+        result |= (uint32_t)(bytes[n] & 0x7f) << (7 * n);
+    } while (bytes[n++] & 0x80);
+    *value = result;
+    return n;
 }
 
-/**
- *
- * @category Stack2 functions
- *
- */
-
-// Push data in a stack.
-void Stack_push(alu_Stack **stack, void *data)
-{
-    alu_Stack *slate = (alu_Stack *)malloc(sizeof(alu_Stack));
-    if (slate == null)
-        raise(AERR_NOMEM,);
-    memset(slate, 0, sizeof(alu_Stack));
-    slate->previous = (*stack != null ? (*stack)->top : null);
-    slate->next = null;
-    slate->data = data;
-    if (*stack == null)
-        *stack = slate;
-    else
-        (*stack)->top->next = slate;
-    (*stack)->top = slate;
-}
-
-// Get the stack len from a pointer.
-alu_Size Stack_len(alu_Stack *from)
-{
-    alu_Size n = 0;
-    if (from == null)
-        return n;
-    for (; from->next != null; ++n)
-        from = from->next;
-    return n + 1;
-}
-
-// View pointers in the stack.
-void Stack_view(alu_Stack *from)
+/// Reads a zigzag LEB128 varint of at most 32 bits in `value`.
+/// Returns its length, or 0 if it doesn't fit.
+/// `03 -> (int32_t) -2`
+size_t bytessleb(const alu_Byte *bytes, int32_t *value)
 {
-    printf("[");
-    while (from)
-    {
-        printf("(%p)", from);
-        from = from->next;
-        if (from != null)
-            printf(" -> ");
-    }
-    printf("]\n");
+    uint32_t raw = 0;
+    size_t n = bytesuleb(bytes, &raw);
+    *value = (int32_t)((raw >> 1) ^ -(raw & 1));
+    return n;
 }
 
 /**
@@ -360,394 +604,1132 @@ void Stack_view(alu_Stack *from)
  *
  */
 
+// Set when the program has to stop, cleared when a program starts.
+static volatile sig_atomic_t __Alu_interrupted = 0;
+
 // Handles a signal
 void __Alu_sighandler(int sig)
 {
     if (sig == SIGINT)
-        errno = 1;
+        __Alu_interrupted = 1;
 }
 
-// Get the size from an `alu_Type`.
-size_t Alu_sizeoftype(alu_Type t)
+/**
+ *
+ * @category Alu memory
+ *
+ */
+
+// Allocates `size` bytes that live as long as the `alu_State`.
+void *Alu_arenalloc(alu_State *A, size_t size)
 {
-    switch (t)
+    alu_Arena *chunk = A->arena;
+    size_t chunksize = ALU_ARENA_CHUNK;
+    void *ptr = null;
+
+    size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+    if ((chunk == null) or (chunk->size - chunk->used < size))
     {
-    case ALU_BOOL:
-        return sizeof(_Bool);
-    case ALU_NUMBER:
-        return sizeof(alu_Number);
-    case ALU_STRING:
-    case ALU_NULL:
-    default:
-        return 0;
+        while (chunksize < size)
+            chunksize <<= 1;
+        chunk = (alu_Arena *)malloc(sizeof(alu_Arena) + chunksize);
+        if (chunk == null)
+            raise(A, AERR_NOMEM, null);
+        chunk->next = A->arena;
+        chunk->used = 0;
+        chunk->size = chunksize;
+        A->arena = chunk;
     }
+    ptr = (alu_Byte *)chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
 }
 
-// Return the pointer depending on the type.
-void *Alu_alloctype(alu_Type t)
+// Frees every chunk of the arena.
+void Alu_arenaclose(alu_State *A)
 {
-    size_t n = Alu_sizeoftype(t);
-    if (n == 0)
-        return null;
-    return malloc(n);
+    alu_Arena *next = null;
+    for (; A->arena != null; A->arena = next)
+    {
+        next = A->arena->next;
+        remove(A->arena);
+    }
+    memset(A->freestrings, 0, sizeof(A->freestrings));
 }
 
 /**
  *
- * @category Alu string casting
+ * @category Alu strings
  *
  */
 
-void __Alu_abstracttoa(alu_Variable *var)
+// Size class of a string object of `size` bytes.
+// Returns `ALU_STRING_CLASSES` if the string is too big to be recycled.
+static inline unsigned __Alu_stringclass(size_t size)
+{
+    unsigned class = 0;
+    while ((class < ALU_STRING_CLASSES) and ((size_t)32 << class) < size)
+        ++class;
+    return class;
+}
+
+// Size in bytes of the string object `str`.
+static inline size_t __Alu_stringsize(const alu_StringObject *str)
+{
+    if (str->flags & ALU_STR_ROPE)
+        return sizeof(alu_StringObject) + sizeof(alu_StringObject *) * 2;
+    return sizeof(alu_StringObject) + str->len + 1;
+}
+
+// Allocates a string object of `size` bytes.
+alu_StringObject *__Alu_allocobject(alu_State *A, size_t size)
 {
-    char *hex = "0123456789abcdef";
-    unsigned short base = 16;
-    uintptr_t ptr = (uintptr_t)var->data;
-    size_t nblen = 0;
-    alu_String str = null;
+    unsigned class = __Alu_stringclass(size);
+    alu_StringObject *str = null;
 
-    remove(var->data);
-    var->data = null;
-    for (uintptr_t n = ptr; n; n /= base)
-        ++nblen;
-    str = (char *)malloc(sizeof(char) * (nblen + 2 + 1));
+    if (class == ALU_STRING_CLASSES)
+        str = (alu_StringObject *)malloc(size);
+    else if (A->freestrings[class] != null)
+    {
+        str = A->freestrings[class];
+        A->freestrings[class] = *(void **)str;
+    }
+    else
+        str = Alu_arenalloc(A, (size_t)32 << class);
     if (str == null)
-        return;
-    memset(str, 0, (nblen + 2 + 1));
-    size_t index = 0;
-    for (; ptr; ptr /= base)
-        str[index++] = hex[ptr % base];
-    strcat(str, "x0");
-    strrev(str);
-    var->data = str;
+        raise(A, AERR_NOMEM, null);
+    str->refs = 1;
+    str->hash = 0;
+    str->flags = 0;
+    return str;
 }
 
-/// Converts a bool to an alu_String
-void __Alu_btoa(alu_Variable *var)
+// Allocates a string object of `len` characters, with only the
+// terminating character set.
+alu_StringObject *Alu_allocstring(alu_State *A, alu_Size len)
+{
+    alu_StringObject *str = __Alu_allocobject(
+        A, sizeof(alu_StringObject) + sizeof(char) * (len + 1));
+    if (str == null)
+        return null;
+    str->len = len;
+    str->chars[len] = '\0';
+    return str;
+}
+
+// Creates a string object from `len` characters of `chars`.
+alu_StringObject *Alu_newstring(alu_State *A, const char *chars, alu_Size len)
 {
-    _Bool value = *((_Bool *)var->data);
-    remove(var->data);
-    var->data = strdup(value ? "true" : "false");
+    alu_StringObject *str = Alu_allocstring(A, len);
+    if (str != null)
+        memcpy(str->chars, chars, len);
+    return str;
 }
 
-/// Converts null to string
-void __Alu_nulltoa(alu_Variable *var)
+// Adds a reference to `str`.
+static inline alu_StringObject *Alu_retainstring(alu_StringObject *str)
 {
-    var->data = strdup("null");
+    if (not (str->flags & ALU_STR_CONST))
+        ++str->refs;
+    return str;
 }
 
-/// Fill string with the double.
-void __Alu_ntoa_fillbuf(alu_String buf, size_t *infos)
+// Drops a reference to `str`, freeing it with the last one.
+// Ropes free their left strings in a loop, never recursively.
+void Alu_releasestring(alu_State *A, alu_StringObject *str)
 {
-    size_t index = 0;
-    if (infos[2])
+    alu_StringObject *left = null;
+    unsigned class = 0;
+    for (; (str != null) and not (str->flags & ALU_STR_CONST) and
+           (--str->refs == 0);
+         str = left)
     {
-        for (; infos[2]; infos[2] /= 10)
-            buf[index++] = '0' + (infos[2] % 10);
-        ((alu_String)buf)[index++] = '.';
+        left = null;
+        if (str->flags & ALU_STR_ROPE)
+        {
+            left = ALU_ROPE_LEFT(str);
+            Alu_releasestring(A, ALU_ROPE_RIGHT(str));
+        }
+        class = __Alu_stringclass(__Alu_stringsize(str));
+        if (class == ALU_STRING_CLASSES)
+        {
+            free(str);
+            continue;
+        }
+        *(void **)str = A->freestrings[class];
+        A->freestrings[class] = str;
     }
-    for (; infos[1]; infos[1] /= 10)
-        buf[index++] = '0' + (infos[1] % 10);
-    if (infos[3])
-        ((alu_String)buf)[index++] = '-';
-    remove(infos);
-    strrev(buf);
 }
 
-/// Get a pointer to :
-/// [0] = total, [1] = int, [2] = fract, [3] = signed
-size_t *__Alu_ntoa_infos(alu_Number num, size_t precision)
+// Returns the flat string holding the characters of `str`.
+// A rope is flattened the first time it is observed and keeps the result.
+alu_StringObject *Alu_flatten(alu_State *A, alu_StringObject *str)
 {
-    size_t *part = (size_t *)malloc(sizeof(size_t) * 4);
-    if (part == null)
+    alu_StringObject *flat = null, *node = str;
+    alu_Size pos = str->len;
+
+    if (not (str->flags & ALU_STR_ROPE))
+        return str;
+    if (ALU_ROPE_RIGHT(str) == null)
+        return ALU_ROPE_LEFT(str);
+    flat = Alu_allocstring(A, str->len);
+    if (flat == null)
         return null;
-    memset(part, 0, sizeof(size_t) * 4);
-    num *= ((num < 0) ? -((short)(part[0] += ++part[3])) : 1);
-    for (size_t n = (part[1] = (size_t)num); n > 0; n /= 10)
-        ++(part[0]);
-    num -= (short)num;
-    for (; precision--;
-         part[2] *= ((!(int)(num * 10)) ? 1 : 10), part[2] += (num *= 10))
-        num -= (short)num;
-    part[0] += (part[2] != 0);
-    for (size_t n = part[2]; n > 0; n /= 10)
-        ++(part[0]);
-    return part;
+    for (; (node->flags & ALU_STR_ROPE) and (ALU_ROPE_RIGHT(node) != null);
+         node = ALU_ROPE_LEFT(node))
+    {
+        pos -= ALU_ROPE_RIGHT(node)->len;
+        memcpy(flat->chars + pos,
+               ALU_ROPE_RIGHT(node)->chars, ALU_ROPE_RIGHT(node)->len);
+    }
+    if (node->flags & ALU_STR_ROPE)
+        node = ALU_ROPE_LEFT(node);
+    memcpy(flat->chars, node->chars, node->len);
+    Alu_releasestring(A, ALU_ROPE_LEFT(str));
+    Alu_releasestring(A, ALU_ROPE_RIGHT(str));
+    ALU_ROPE_LEFT(str) = flat;
+    ALU_ROPE_RIGHT(str) = null;
+    return flat;
 }
 
-// Converts an alu number into a string.
-void __Alu_ntoa(alu_Variable *var)
+// Returns the concatenation of `a` and `b`.
+// Short results are copied, long ones are ropes flattened when observed.
+alu_StringObject *Alu_concat(alu_State *A, alu_StringObject *a,
+                             alu_StringObject *b)
 {
-    alu_Number num = *((alu_Number *)var->data);
-    size_t *infos = __Alu_ntoa_infos(num, 6);
-    remove(var->data);
-    var->data = null;
-    if (infos == null)
-        raise(AERR_NOMEM, );
-    var->data = (alu_String)malloc(sizeof(char) * (infos[0] + 1));
-    if (var->data == null)
+    alu_StringObject *str = null;
+
+    if ((b = Alu_flatten(A, b)) == null)
+        return null;
+    if ((a->flags & ALU_STR_ROPE) and (ALU_ROPE_RIGHT(a) == null))
+        a = ALU_ROPE_LEFT(a);
+    if (a->len + b->len <= ALU_ROPE_MIN)
     {
-        remove(infos);
-        raise(AERR_NOMEM, );
+        if ((a = Alu_flatten(A, a)) == null)
+            return null;
+        str = Alu_allocstring(A, a->len + b->len);
+        if (str == null)
+            return null;
+        memcpy(str->chars, a->chars, a->len);
+        memcpy(str->chars + a->len, b->chars, b->len);
+        return str;
     }
-    memset(var->data, 0, (infos[0] + 1));
-    __Alu_ntoa_fillbuf(var->data, infos);
+    str = __Alu_allocobject(
+        A, sizeof(alu_StringObject) + sizeof(alu_StringObject *) * 2);
+    if (str == null)
+        return null;
+    str->len = a->len + b->len;
+    str->flags = ALU_STR_ROPE;
+    ALU_ROPE_LEFT(str) = Alu_retainstring(a);
+    ALU_ROPE_RIGHT(str) = Alu_retainstring(b);
+    return str;
 }
 
-// Converts a variable of any type to a string.
-void Alu_vartostring(alu_Variable *var)
+// FNV-1a hash of `len` characters of `chars`, never 0.
+alu_Size __Alu_hash(const char *chars, alu_Size len)
 {
-    if (var->type == ALU_STRING)
-        return;
-    ((void (*)(alu_Variable *))CONVERT_STRING[var->type])(var);
-    var->type = ALU_STRING;
+    alu_Size hash = 2166136261u;
+    for (alu_Size n = 0; n < len; ++n)
+        hash = (hash ^ (alu_Byte)chars[n]) * 16777619u;
+    return (hash ? hash : 1);
 }
 
-// Converts stack[0] into a string.
-void Alu_tostring(alu_State *A)
+// Returns the hash of the flat string `str`, computing it the first time.
+alu_Size Alu_stringhash(alu_StringObject *str)
 {
-    if (A->stack == null)
-        raise(AERR_STKLN, );
-    Alu_vartostring(A->stack->data);
+    if (str->hash == 0)
+        str->hash = __Alu_hash(str->chars, str->len);
+    return str->hash;
 }
 
-/**
- *
- * @category Alu variable
- *
- */
+// Returns true if the flat strings `a` and `b` hold the same characters.
+// Lengths and hashes are compared before the characters.
+_Bool Alu_streq(alu_StringObject *a, alu_StringObject *b)
+{
+    if (a == b)
+        return true;
+    if ((a->len != b->len) or (Alu_stringhash(a) != Alu_stringhash(b)))
+        return false;
+    return memcmp(a->chars, b->chars, a->len) == 0;
+}
 
-// Create a `alu_Variable`.
-alu_Variable *Alu_newvariable(alu_Type type, void *data)
+// Compares the flat strings `a` and `b` like `strcmp`, returns -1, 0 or 1.
+int Alu_strcmp(alu_StringObject *a, alu_StringObject *b)
 {
-    alu_Variable *var = (alu_Variable *)malloc(sizeof(alu_Variable));
-    if (var == null)
-        raise(AERR_NOMEM, null);
-    if (data == null or type == ALU_NULL)
-        return null;
-    var->type = type;
-    var->data = data;
-    return var;
+    int res = memcmp(a->chars, b->chars, (a->len < b->len ? a->len : b->len));
+    if (res == 0)
+        res = (a->len > b->len) - (a->len < b->len);
+    return (res > 0) - (res < 0);
+}
+
+// Grows the constant pool to `cap` slots.
+_Bool __Alu_poolgrow(alu_State *A, alu_Size cap)
+{
+    alu_Pool *pool = &A->constants;
+    alu_StringObject **slots = Alu_arenalloc(A, sizeof(*slots) * cap);
+    alu_Size n = 0;
+    if (slots == null)
+        return false;
+    memset(slots, 0, sizeof(*slots) * cap);
+    for (alu_Size i = 0; i < pool->cap; ++i)
+    {
+        if (pool->slots[i] == null)
+            continue;
+        n = pool->slots[i]->hash & (cap - 1);
+        while (slots[n] != null)
+            n = (n + 1) & (cap - 1);
+        slots[n] = pool->slots[i];
+    }
+    pool->slots = slots;
+    pool->cap = cap;
+    return true;
 }
 
-/// Returns a copy of this variable.
-alu_Variable *Alu_cpyvar(alu_Variable *src)
+// Returns the constant string made of `len` characters of `chars`,
+// creating it in the constant pool the first time.
+alu_StringObject *Alu_intern(alu_State *A, const char *chars, alu_Size len)
 {
-    alu_Variable *dest = (alu_Variable *)malloc(sizeof(alu_Variable));
-    size_t s = Alu_sizeoftype(src->type);
-    s = ((s == 0 and src->type == ALU_STRING) ?
-    ((strlen(src->data) + 1) * sizeof(char)) : s);
-    if (s == 0)
+    alu_Pool *pool = &A->constants;
+    alu_Size hash = __Alu_hash(chars, len), n = 0;
+    alu_StringObject *str = null;
+
+    if (((pool->len + 1) * 2 > pool->cap) and
+        not __Alu_poolgrow(A, pool->cap ? pool->cap * 2 : 16))
+        return null;
+    for (n = hash & (pool->cap - 1); (str = pool->slots[n]) != null;
+         n = (n + 1) & (pool->cap - 1))
+        if ((str->hash == hash) and (str->len == len) and
+            (memcmp(str->chars, chars, len) == 0))
+            return str;
+    str = Alu_arenalloc(A, sizeof(alu_StringObject) + len + 1);
+    if (str == null)
         return null;
-    dest->data = malloc(s);
-    dest->type = src->type;
-    if (dest->data != null)
-        memcpy(dest->data, src->data, s);
-    return dest;
+    str->refs = 1;
+    str->len = len;
+    str->hash = hash;
+    str->flags = ALU_STR_CONST;
+    memcpy(str->chars, chars, len);
+    str->chars[len] = '\0';
+    pool->slots[n] = str;
+    ++pool->len;
+    return str;
 }
 
 /**
  *
- * @category Alu Stack Manipulation
+ * @category Alu number formatting
  *
  */
 
-/// Removes stack[0] from the stack.
-/// `[a, b, c] -> [b, c]`
-void Alu_popk(alu_State *A)
+// A number `f * 2^e` with a 64 bits significand.
+typedef struct
 {
-    alu_Stack *next = null;
-    alu_Variable *var = null;
-    if (A->stack == null)
-        return;
-    next = A->stack->next;
-    var = A->stack->data;
-    if (var->type != ALU_NULL and var->type != ALU_ABSTRACT)
-        remove(var->data);
-    remove(var);
-    remove(A->stack);
-    A->stack = next;
-}
+    uint64_t f;
+    int e;
+} alu_Fp;
+
+// `10^k` for `k = -348, -340, ..., 340`, as normalized `alu_Fp`.
+static const alu_Fp CACHED_POWERS[] = {
+    {0xfa8fd5a0081c0288, -1220}, {0xbaaee17fa23ebf76, -1193},
+    {0x8b16fb203055ac76, -1166}, {0xcf42894a5dce35ea, -1140},
+    {0x9a6bb0aa55653b2d, -1113}, {0xe61acf033d1a45df, -1087},
+    {0xab70fe17c79ac6ca, -1060}, {0xff77b1fcbebcdc4f, -1034},
+    {0xbe5691ef416bd60c, -1007}, {0x8dd01fad907ffc3c, -980},
+    {0xd3515c2831559a83, -954}, {0x9d71ac8fada6c9b5, -927},
+    {0xea9c227723ee8bcb, -901}, {0xaecc49914078536d, -874},
+    {0x823c12795db6ce57, -847}, {0xc21094364dfb5637, -821},
+    {0x9096ea6f3848984f, -794}, {0xd77485cb25823ac7, -768},
+    {0xa086cfcd97bf97f4, -741}, {0xef340a98172aace5, -715},
+    {0xb23867fb2a35b28e, -688}, {0x84c8d4dfd2c63f3b, -661},
+    {0xc5dd44271ad3cdba, -635}, {0x936b9fcebb25c996, -608},
+    {0xdbac6c247d62a584, -582}, {0xa3ab66580d5fdaf6, -555},
+    {0xf3e2f893dec3f126, -529}, {0xb5b5ada8aaff80b8, -502},
+    {0x87625f056c7c4a8b, -475}, {0xc9bcff6034c13053, -449},
+    {0x964e858c91ba2655, -422}, {0xdff9772470297ebd, -396},
+    {0xa6dfbd9fb8e5b88f, -369}, {0xf8a95fcf88747d94, -343},
+    {0xb94470938fa89bcf, -316}, {0x8a08f0f8bf0f156b, -289},
+    {0xcdb02555653131b6, -263}, {0x993fe2c6d07b7fac, -236},
+    {0xe45c10c42a2b3b06, -210}, {0xaa242499697392d3, -183},
+    {0xfd87b5f28300ca0e, -157}, {0xbce5086492111aeb, -130},
+    {0x8cbccc096f5088cc, -103}, {0xd1b71758e219652c, -77},
+    {0x9c40000000000000, -50}, {0xe8d4a51000000000, -24},
+    {0xad78ebc5ac620000, 3}, {0x813f3978f8940984, 30},
+    {0xc097ce7bc90715b3, 56}, {0x8f7e32ce7bea5c70, 83},
+    {0xd5d238a4abe98068, 109}, {0x9f4f2726179a2245, 136},
+    {0xed63a231d4c4fb27, 162}, {0xb0de65388cc8ada8, 189},
+    {0x83c7088e1aab65db, 216}, {0xc45d1df942711d9a, 242},
+    {0x924d692ca61be758, 269}, {0xda01ee641a708dea, 295},
+    {0xa26da3999aef774a, 322}, {0xf209787bb47d6b85, 348},
+    {0xb454e4a179dd1877, 375}, {0x865b86925b9bc5c2, 402},
+    {0xc83553c5c8965d3d, 428}, {0x952ab45cfa97a0b3, 455},
+    {0xde469fbd99a05fe3, 481}, {0xa59bc234db398c25, 508},
+    {0xf6c69a72a3989f5c, 534}, {0xb7dcbf5354e9bece, 561},
+    {0x88fcf317f22241e2, 588}, {0xcc20ce9bd35c78a5, 614},
+    {0x98165af37b2153df, 641}, {0xe2a0b5dc971f303a, 667},
+    {0xa8d9d1535ce3b396, 694}, {0xfb9b7cd9a4a7443c, 720},
+    {0xbb764c4ca7a44410, 747}, {0x8bab8eefb6409c1a, 774},
+    {0xd01fef10a657842c, 800}, {0x9b10a4e5e9913129, 827},
+    {0xe7109bfba19c0c9d, 853}, {0xac2820d9623bf429, 880},
+    {0x80444b5e7aa7cf85, 907}, {0xbf21e44003acdd2d, 933},
+    {0x8e679c2f5e44ff8f, 960}, {0xd433179d9c8cb841, 986},
+    {0x9e19db92b4e31ba9, 1013}, {0xeb96bf6ebadf77d9, 1039},
+    {0xaf87023b9bf0ee6b, 1066}
+};
 
-/// Clears the stack of the `alu_State`.
-/// `[a, b, c] -> []`
-void Alu_stackclose(alu_State *A)
+static const uint64_t POW10[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+    10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+    100000000000ull, 1000000000000ull, 10000000000000ull,
+    100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull, 1000000000000000000ull,
+    10000000000000000000ull,
+};
+
+// Product of `x` and `y`, rounded to 64 bits.
+static inline alu_Fp __Alu_fpmul(alu_Fp x, alu_Fp y)
 {
-    while (A->stack != null)
-        Alu_popk(A);
+    const uint64_t m32 = 0xffffffffull;
+    uint64_t a = x.f >> 32, b = x.f & m32, c = y.f >> 32, d = y.f & m32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t mid = (bd >> 32) + (ad & m32) + (bc & m32) + (1ull << 31);
+    return (alu_Fp){ac + (ad >> 32) + (bc >> 32) + (mid >> 32), x.e + y.e + 64};
 }
 
-/// Pushes an allocated version of `ptr` of type `t` in the stack.
-/// `Code -> Stack`
-void Alu_push(alu_State *A, const void *ptr, size_t s, alu_Type t)
+// Shifts `x` until its highest bit is set.
+static inline alu_Fp __Alu_fpnormalize(alu_Fp x)
 {
-    alu_Variable *var = null;
-    void *data = null;
-    data = malloc(s);
-    if (data != null)
+    while (not (x.f & (1ull << 63)))
     {
-        memset(data, 0, s);
-        memcpy(data, ptr, s);
+        x.f <<= 1;
+        --x.e;
     }
-    else
+    return x;
+}
+
+// Moves the last digit of `buf` toward the exact value while it stays
+// within the rounding interval (Grisu2 round weed).
+static inline void __Alu_grisuround(char *buf, int len, uint64_t delta,
+                                    uint64_t rest, uint64_t tenkappa,
+                                    uint64_t distance)
+{
+    while ((rest < distance) and (delta - rest >= tenkappa) and
+           ((rest + tenkappa < distance) or
+            (distance - rest > rest + tenkappa - distance)))
     {
-        errno = ENOMEM;
-        return;
+        --buf[len - 1];
+        rest += tenkappa;
     }
-    var = Alu_newvariable(t, data);
-    if (var == null)
-        return;
-    Stack_push(&A->stack, var);
 }
 
-/// Push a number in the stack.
-void Alu_pushnumber(alu_State *A, alu_Number num)
+// Writes the shortest digits of `w` within `[high - delta, high]` in
+// `buf`, `*k` is updated with the decimal exponent.
+static int __Alu_grisudigits(alu_Fp w, alu_Fp high, uint64_t delta,
+                             char *buf, int *k)
 {
-    Alu_push(A, &num, sizeof(alu_Number), ALU_NUMBER);
+    const alu_Fp one = {1ull << -high.e, high.e};
+    const uint64_t distance = high.f - w.f;
+    uint32_t p1 = (uint32_t)(high.f >> -one.e), d = 0;
+    uint64_t p2 = high.f & (one.f - 1), rest = 0;
+    int kappa = 1, len = 0;
+
+    while ((kappa < 10) and (p1 >= POW10[kappa]))
+        ++kappa;
+    while (kappa > 0)
+    {
+        d = p1 / (uint32_t)POW10[kappa - 1];
+        p1 %= (uint32_t)POW10[kappa - 1];
+        if (d or len)
+            buf[len++] = (char)('0' + d);
+        --kappa;
+        rest = ((uint64_t)p1 << -one.e) + p2;
+        if (rest <= delta)
+        {
+            *k += kappa;
+            __Alu_grisuround(buf, len, delta, rest,
+                             POW10[kappa] << -one.e, distance);
+            return len;
+        }
+    }
+    while (true)
+    {
+        p2 *= 10;
+        delta *= 10;
+        d = (uint32_t)(p2 >> -one.e);
+        if (d or len)
+            buf[len++] = (char)('0' + d);
+        p2 &= one.f - 1;
+        --kappa;
+        if (p2 < delta)
+        {
+            *k += kappa;
+            __Alu_grisuround(buf, len, delta, p2, one.f,
+                             distance * (-kappa < 20 ? POW10[-kappa] : 0));
+            return len;
+        }
+    }
 }
 
-/// Push a boolean in the stack.
-void Alu_pushbool(alu_State *A, _Bool b)
-{
-    Alu_push(A, &b, sizeof(_Bool), ALU_BOOL);
+// Grisu2: writes the shortest digits that read back as the positive
+// finite number of bits `bits`. Returns the number of digits, the value
+// is `digits * 10^k`.
+static int __Alu_grisu2(uint64_t bits, char *buf, int *k)
+{
+    const uint64_t hidden = 1ull << 52;
+    int bexp = (int)((bits >> 52) & 0x7ff);
+    alu_Fp v = {bits & (hidden - 1), 1 - 1075};
+    alu_Fp high = {0}, low = {0}, cached = {0};
+    double dk = 0;
+    int index = 0;
+
+    if (bexp != 0)
+        v = (alu_Fp){v.f + hidden, bexp - 1075};
+    high = (alu_Fp){(v.f << 1) + 1, v.e - 1};
+    while (not (high.f & (hidden << 1)))
+    {
+        high.f <<= 1;
+        --high.e;
+    }
+    high.f <<= 64 - 52 - 2;
+    high.e -= 64 - 52 - 2;
+    low = (v.f == hidden) ? (alu_Fp){(v.f << 2) - 1, v.e - 2}
+                          : (alu_Fp){(v.f << 1) - 1, v.e - 1};
+    low.f <<= low.e - high.e;
+    low.e = high.e;
+    dk = (-61 - high.e) * 0.30102999566398114 + 347;
+    index = (int)dk;
+    if (dk - index > 0.0)
+        ++index;
+    index = (index >> 3) + 1;
+    *k = -(-348 + index * 8);
+    cached = CACHED_POWERS[index];
+    v = __Alu_fpmul(__Alu_fpnormalize(v), cached);
+    high = __Alu_fpmul(high, cached);
+    low = __Alu_fpmul(low, cached);
+    ++low.f;
+    --high.f;
+    return __Alu_grisudigits(v, high, high.f - low.f, buf, k);
 }
 
-/// Push a string in the stack.
-void Alu_pushstring(alu_State *A, const alu_String str)
+// Writes the decimal digits of `n` in `buf`, returns their count.
+static inline size_t __Alu_utoa(uint64_t n, char *buf)
 {
-    Alu_push(A, str, ((strlen(str) + 1) * sizeof(char)), ALU_STRING);
+    char tmp[20];
+    size_t len = 0;
+    do
+        tmp[len++] = (char)('0' + n % 10);
+    while (n /= 10);
+    for (size_t i = 0; i < len; ++i)
+        buf[i] = tmp[len - 1 - i];
+    return len;
 }
 
-/// Pushes a C pointer to the stack.
-void Alu_pushabstract(alu_State *A, void *pointer)
+// Lays out `len` digits times `10^k` like JavaScript does: plain
+// notation from 1e-7 to 1e21, exponent notation otherwise.
+static size_t __Alu_layoutdigits(char *buf, int len, int k)
 {
-    alu_Variable *var = Alu_newvariable(ALU_ABSTRACT, pointer);
-    if (var == null)
-        return;
-    Stack_push(&A->stack, var);
+    int point = len + k;
+    if ((len <= point) and (point <= 21))
+    {
+        memset(buf + len, '0', point - len);
+        return point;
+    }
+    if ((0 < point) and (point <= 21))
+    {
+        memmove(buf + point + 1, buf + point, len - point);
+        buf[point] = '.';
+        return len + 1;
+    }
+    if ((-6 < point) and (point <= 0))
+    {
+        memmove(buf + 2 - point, buf, len);
+        buf[0] = '0';
+        buf[1] = '.';
+        memset(buf + 2, '0', -point);
+        return 2 - point + len;
+    }
+    if (len > 1)
+    {
+        memmove(buf + 2, buf + 1, len - 1);
+        buf[1] = '.';
+        ++len;
+    }
+    buf[len++] = 'e';
+    buf[len++] = (point - 1 < 0 ? '-' : '+');
+    return len + __Alu_utoa(point - 1 < 0 ? 1 - point : point - 1, buf + len);
 }
 
-/// Pushes a fefault functions
-void Alu_pushdef(alu_State *A, alu_String str)
+// Writes the shortest string that reads back as `num` in `buf`, which
+// holds at least `ALU_NUMBER_BUFSIZE` characters.
+// Returns the length of the string, which is not terminated.
+size_t Alu_numtostr(alu_Number num, char *buf)
 {
-    for (size_t n = 0; DEF[n].name != null; ++n)
-        if (strcmp(DEF[n].name, str) == 0)
-            return Alu_pushabstract(A, DEF[n].f);
-    raise(AERR_NOFND, );
+    uint64_t bits = 0;
+    size_t sign = 0;
+    int len = 0, k = 0;
+
+    memcpy(&bits, &num, sizeof(bits));
+    if (bits >> 63)
+        buf[sign++] = '-';
+    bits &= ~(1ull << 63);
+    if ((bits >> 52) == 0x7ff)
+    {
+        if (bits << 12)
+            sign = 0;
+        memcpy(buf + sign, ((bits << 12) ? "nan" : "inf"), 3);
+        return sign + 3;
+    }
+    if (bits == 0)
+    {
+        buf[sign] = '0';
+        return sign + 1;
+    }
+    num = (sign ? -num : num);
+    if ((num < 9007199254740992.0) and (num == (alu_Number)(uint64_t)num))
+        return sign + __Alu_utoa((uint64_t)num, buf + sign);
+    len = __Alu_grisu2(bits, buf + sign, &k);
+    return sign + __Alu_layoutdigits(buf + sign, len, k);
 }
 
-/// Pop a value from the stack and return it.
-alu_Variable *Alu_pop(alu_State *A)
+// Writes the integer `num` in `buf`, which holds at least
+// `ALU_NUMBER_BUFSIZE` characters, as `Alu_numtostr` writes its double.
+// Returns the length of the string, which is not terminated.
+size_t Alu_inttostr(alu_Integer num, char *buf)
 {
-    alu_Stack *link = null;
-    alu_Variable *var = null;
-    if (A->stack == null)
-        return null;
-    link = A->stack;
-    A->stack = link->next;
-    var = (alu_Variable *)link->data;
-    remove(link);
-    Stack_push(&A->garbage, var);
-    return var;
+    if (num >= 0)
+        return __Alu_utoa((uint64_t)num, buf);
+    buf[0] = '-';
+    return 1 + __Alu_utoa((uint64_t)-num, buf + 1);
 }
 
-// Get a variable from the stack index.
-alu_Variable *Alu_get(alu_State *A, alu_Size index)
-{
-    alu_Stack *link = null;
-    link = A->stack;
-    for (; index; link = (link ? link->next : null))
-        --index;
-    if (link == null)
-        raise(AERR_NOSTK, null);
-    return ((alu_Variable *)link->data);
+/**
+ *
+ * @category Alu string casting
+ *
+ */
+
+// Writes `pointer` in hexadecimal in `buf`, which holds at least
+// `ALU_POINTER_BUFSIZE` characters. Returns the length written.
+size_t __Alu_ptrtostr(const void *pointer, char *buf)
+{
+    const char *hex = "0123456789abcdef";
+    uintptr_t ptr = (uintptr_t)pointer;
+    size_t len = 2;
+
+    for (uintptr_t rest = ptr; rest; rest >>= 4)
+        ++len;
+    buf[0] = '0';
+    buf[1] = 'x';
+    for (size_t index = len; ptr; ptr >>= 4)
+        buf[--index] = hex[ptr & 0xf];
+    return len;
 }
 
-/// Get a alu_Number from the Stack.
-/// `Stack -> Code`
-alu_Number Alu_getnumber(alu_State *A, alu_Size index)
+void __Alu_abstracttoa(alu_State *A, alu_Variable *var)
 {
-    alu_Variable *var = Alu_get(A, index);
-    if (var == null)
-        return 0;
-    return *((alu_Number *)var->data);
+    char str[ALU_POINTER_BUFSIZE];
+    size_t len = __Alu_ptrtostr(var->as.abstract, str);
+    var->as.string = Alu_newstring(A, str, len);
 }
 
-/// Get a boolean from the stack.
-/// `Stack -> Code`
-_Bool Alu_getbool(alu_State *A, alu_Size index)
+/// Converts a bool to an alu_String
+void __Alu_btoa(alu_State *A, alu_Variable *var)
 {
-    alu_Variable *var = Alu_get(A, index);
-    if (var == null)
-        return 0;
-    return *((_Bool *)var->data);
+    var->as.string = (var->as.boolean ?
+        Alu_newstring(A, "true", 4) : Alu_newstring(A, "false", 5));
 }
 
-/// Get a string from the stack.
-/// `Stack -> Code`
-alu_String Alu_getstring(alu_State *A, alu_Size index)
+/// Converts null to string
+void __Alu_nulltoa(alu_State *A, alu_Variable *var)
 {
-    alu_Variable *var = Alu_get(A, index);
-    if (var == null)
-        return "";
-    return (alu_String)var->data;
+    var->as.string = Alu_newstring(A, "null", 4);
 }
 
-// Process the sum of 2 variables
-static void *Alu_sumvar(alu_Variable *a, alu_Variable *b)
+// Converts an alu number into a string.
+void __Alu_ntoa(alu_State *A, alu_Variable *var)
 {
-    void *data = Alu_alloctype(a->type);
-    size_t len = 0;
-    if ((data == null) and (a->type != ALU_STRING))
-        return null;
-    switch (a->type)
-    {
-    case ALU_NUMBER:
-        *(alu_Number *)data = (*(alu_Number *)a->data + *(alu_Number *)b->data);
-        break;
-    case ALU_BOOL:
-        *(_Bool *)data = (*(_Bool *)a->data + *(_Bool *)b->data);
-        break;
-    case ALU_STRING:
-        len = strlen((alu_String)a->data) + strlen((alu_String)b->data);
-        data = malloc(sizeof(char) * (len + 1));
-        if (data == null)
-            return null;
-        memset(data, 0, len + 1);
-        strcpy(data, a->data);
-        strcat(data, b->data);
-        break;
-    default:
-        remove(data)
-            data = null;
-        return null;
-    }
-    return data;
+    char buf[ALU_NUMBER_BUFSIZE];
+    size_t len = Alu_numtostr(var->as.number, buf);
+    var->as.string = Alu_newstring(A, buf, len);
 }
 
-/// Sum stack[0] and stack[1] and pushes the result into the stack.
-void Alu_sumstack(alu_State *A)
+// Converts an alu integer into a string.
+void __Alu_itoa(alu_State *A, alu_Variable *var)
 {
-    alu_Variable *a = null, *b = null;
-    alu_Type t = ALU_NULL;
-    void *data = null;
-    if (Stack_len(A->stack) < 2)
-        raise(AERR_STKLN, );
-    a = Alu_get(A, 0);
-    b = Alu_get(A, 1);
-    if (a->type != b->type)
-        raise(AERR_TYPES, );
-    t = a->type;
-    data = Alu_sumvar(a, b);
-    Alu_stackclose(A);
-    if (t == ALU_STRING)
-        Alu_pushstring(A, data);
-    else
-        Alu_push(A, data, Alu_sizeoftype(t), t);
-    remove(data);
+    char buf[ALU_NUMBER_BUFSIZE];
+    size_t len = Alu_inttostr(var->as.integer, buf);
+    var->as.string = Alu_newstring(A, buf, len);
 }
 
-/**
+// Replaces the rope in `var` by its flat string.
+void Alu_flattenvar(alu_State *A, alu_Variable *var)
+{
+    alu_StringObject *flat = null;
+    if ((var->type != ALU_STRING) or not (var->as.string->flags & ALU_STR_ROPE))
+        return;
+    flat = Alu_flatten(A, var->as.string);
+    if (flat != null)
+        Alu_retainstring(flat);
+    Alu_releasestring(A, var->as.string);
+    var->as.string = flat;
+    if (flat == null)
+        var->type = ALU_NULL;
+}
+
+// Converts a variable of any type to a string.
+void Alu_vartostring(alu_State *A, alu_Variable *var)
+{
+    if (var->type == ALU_STRING)
+        return Alu_flattenvar(A, var);
+    ((void (*)(alu_State *, alu_Variable *))CONVERT_STRING[var->type])(A, var);
+    var->type = ALU_STRING;
+}
+
+// Converts stack[0] into a string.
+void Alu_tostring(alu_State *A)
+{
+    if (A->stack.len == 0)
+        raise(A, AERR_STKLN, );
+    Alu_vartostring(A, ALU_STACK_SLOT(A, 0));
+}
+
+/**
+ *
+ * @category Alu output
+ *
+ */
+
+// Writes all of `iov` to `fd`, retrying on partial writes.
+_Bool __Alu_writev(int fd, struct iovec *iov, int count)
+{
+    ssize_t done = 0;
+    while (count != 0)
+    {
+        done = writev(fd, iov, count);
+        if ((done < 0) and (errno == EINTR))
+            continue;
+        if (done < 0)
+            return false;
+        for (; (count != 0) and ((size_t)done >= iov->iov_len); ++iov, --count)
+            done -= iov->iov_len;
+        if (count != 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return true;
+}
+
+/// Writes the output buffer to its file descriptor.
+/// Does nothing when the output is kept in memory.
+void Alu_flush(alu_State *A)
+{
+    struct iovec iov = {A->out.buf, A->out.len};
+    if ((A->out.fd < 0) or (A->out.len == 0))
+        return;
+    A->out.len = 0;
+    if (not __Alu_writev(A->out.fd, &iov, 1))
+        raise(null, AERR_CWRIT, );
+}
+
+/// Sends the output to `fd` after flushing the pending one.
+/// A negative `fd` keeps the output in memory, see `Alu_output`.
+void Alu_setoutput(alu_State *A, int fd)
+{
+    Alu_flush(A);
+    A->out.len = 0;
+    A->out.fd = fd;
+}
+
+/// Returns the output kept in memory and stores its length in `len`.
+/// The data stays valid until the next write.
+const char *Alu_output(alu_State *A, size_t *len)
+{
+    *len = A->out.len;
+    return A->out.buf;
+}
+
+// Makes room for `len` more bytes in the output buffer, flushing it
+// when full. Returns where they go or null.
+char *__Alu_outreserve(alu_State *A, size_t len)
+{
+    char *buf = null;
+    size_t cap = (A->out.cap ? A->out.cap : ALU_OUTPUT_BUFSIZE);
+
+    if ((A->out.fd >= 0) and (A->out.len + len > ALU_OUTPUT_BUFSIZE))
+        Alu_flush(A);
+    if (A->out.len + len <= A->out.cap)
+        return A->out.buf + A->out.len;
+    while (cap < A->out.len + len)
+        cap *= 2;
+    buf = realloc(A->out.buf, cap);
+    if (buf == null)
+        raise(A, AERR_NOMEM, null);
+    A->out.buf = buf;
+    A->out.cap = cap;
+    return A->out.buf + A->out.len;
+}
+
+/// Appends `len` bytes of `data` to the output.
+/// Big writes go straight to the file descriptor with the pending output.
+void Alu_write(alu_State *A, const char *data, size_t len)
+{
+    char *dst = null;
+    struct iovec iov[2] = {{A->out.buf, A->out.len}, {(void *)data, len}};
+
+    if ((A->out.fd >= 0) and (len >= ALU_OUTPUT_BUFSIZE / 2))
+    {
+        A->out.len = 0;
+        if (not __Alu_writev(A->out.fd, iov, 2))
+            raise(null, AERR_CWRIT, );
+        return;
+    }
+    if ((dst = __Alu_outreserve(A, len)) == null)
+        return;
+    memcpy(dst, data, len);
+    A->out.len += len;
+}
+
+/// Appends the string form of `var` to the output, without converting it.
+void Alu_writevar(alu_State *A, alu_Variable *var)
+{
+    alu_StringObject *str = null;
+    char *dst = null;
+
+    switch (var->type)
+    {
+    case ALU_STRING:
+        if ((str = Alu_flatten(A, var->as.string)) == null)
+            raise(A, AERR_NOMEM, );
+        return Alu_write(A, str->chars, str->len);
+    case ALU_NUMBER:
+        if ((dst = __Alu_outreserve(A, ALU_NUMBER_BUFSIZE)) != null)
+            A->out.len += Alu_numtostr(var->as.number, dst);
+        return;
+    case ALU_INTEGER:
+        if ((dst = __Alu_outreserve(A, ALU_NUMBER_BUFSIZE)) != null)
+            A->out.len += Alu_inttostr(var->as.integer, dst);
+        return;
+    case ALU_BOOL:
+        return (var->as.boolean ?
+            Alu_write(A, "true", 4) : Alu_write(A, "false", 5));
+    case ALU_ABSTRACT:
+        if ((dst = __Alu_outreserve(A, ALU_POINTER_BUFSIZE)) != null)
+            A->out.len += __Alu_ptrtostr(var->as.abstract, dst);
+        return;
+    default:
+        return Alu_write(A, "null", 4);
+    }
+}
+
+/**
+ *
+ * @category Alu variable
+ *
+ */
+
+/// Releases the memory owned by the value of `var`.
+void Alu_freevar(alu_State *A, alu_Variable *var)
+{
+    if (var->type == ALU_STRING)
+        Alu_releasestring(A, var->as.string);
+}
+
+/// Returns a new reference to the value of this variable.
+/// Strings are shared, not copied.
+alu_Variable Alu_refvar(const alu_Variable *src)
+{
+    if ((src->type == ALU_STRING) and (src->as.string != null))
+        Alu_retainstring(src->as.string);
+    return *src;
+}
+
+
+/**
+ *
+ * @category Alu Stack Manipulation
+ *
+ */
+
+/// Makes room for at least `cap` variables in the stack.
+_Bool Alu_stackreserve(alu_State *A, alu_Size cap)
+{
+    alu_Size newcap = (A->stack.cap ? A->stack.cap : 8);
+    alu_Variable *slots = null;
+    if (cap <= A->stack.cap)
+        return true;
+    while (newcap < cap)
+        newcap <<= 1;
+    slots = (alu_Variable *)malloc(sizeof(alu_Variable) * newcap);
+    if (slots == null)
+        raise(A, AERR_NOMEM, false);
+    for (alu_Size n = 0; n < A->stack.len; ++n)
+        slots[n] = *ALU_STACK_SLOT(A, n);
+    remove(A->stack.slots);
+    A->stack.slots = slots;
+    A->stack.head = 0;
+    A->stack.cap = newcap;
+    return true;
+}
+
+/// Removes stack[0] from the stack.
+/// `[a, b, c] -> [b, c]`
+void Alu_popk(alu_State *A)
+{
+    if (A->stack.len == 0)
+        return;
+    Alu_freevar(A, ALU_STACK_SLOT(A, 0));
+    A->stack.head = (A->stack.head + 1) & (A->stack.cap - 1);
+    --A->stack.len;
+}
+
+/// Clears the stack of the `alu_State`.
+/// `[a, b, c] -> []`
+void Alu_stackclose(alu_State *A)
+{
+    for (alu_Size n = 0; n < A->stack.len; ++n)
+        Alu_freevar(A, ALU_STACK_SLOT(A, n));
+    A->stack.head = 0;
+    A->stack.len = 0;
+}
+
+/// Pushes `value` in the stack, the stack takes ownership of its memory.
+/// `Code -> Stack`
+void Alu_push(alu_State *A, alu_Variable value)
+{
+    if ((A->stack.len == A->stack.cap) and
+        not Alu_stackreserve(A, A->stack.len + 1))
+    {
+        Alu_freevar(A, &value);
+        return;
+    }
+    *ALU_STACK_SLOT(A, A->stack.len) = value;
+    ++A->stack.len;
+}
+
+/// Push a number in the stack.
+void Alu_pushnumber(alu_State *A, alu_Number num)
+{
+    Alu_push(A, (alu_Variable){.type = ALU_NUMBER, .as.number = num});
+}
+
+/// Push an integer in the stack, within `ALU_INTEGER_MAX`.
+void Alu_pushinteger(alu_State *A, alu_Integer num)
+{
+    Alu_push(A, (alu_Variable){.type = ALU_INTEGER, .as.integer = num});
+}
+
+/// Push a boolean in the stack.
+void Alu_pushbool(alu_State *A, _Bool b)
+{
+    Alu_push(A, (alu_Variable){.type = ALU_BOOL, .as.boolean = b});
+}
+
+/// Push a string in the stack.
+void Alu_pushstring(alu_State *A, const alu_String str)
+{
+    alu_StringObject *copy = Alu_newstring(A, str, strlen(str));
+    if (copy == null)
+        return;
+    Alu_push(A, (alu_Variable){.type = ALU_STRING, .as.string = copy});
+}
+
+/// Pushes a constant string in the stack, without copying it.
+void Alu_pushconstant(alu_State *A, alu_StringObject *str)
+{
+    Alu_push(A, (alu_Variable){.type = ALU_STRING, .as.string = str});
+}
+
+/// Pushes a C pointer to the stack.
+void Alu_pushabstract(alu_State *A, void *pointer)
+{
+    Alu_push(A, (alu_Variable){.type = ALU_ABSTRACT, .as.abstract = pointer});
+}
+
+/// Returns the index of the default function `str` in `DEF`,
+/// or -1 if there is none.
+long __Alu_finddef(const char *str)
+{
+    for (size_t n = 0; DEF[n].name != null; ++n)
+        if (strcmp(DEF[n].name, str) == 0)
+            return (long)n;
+    return -1;
+}
+
+/// Pushes the default function `DEF[index]`.
+void Alu_pushbuiltin(alu_State *A, alu_Size index)
+{
+    Alu_pushabstract(A, DEF[index].f);
+}
+
+/// Pushes a fefault functions
+void Alu_pushdef(alu_State *A, alu_String str)
+{
+    long index = __Alu_finddef(str);
+    if (index < 0)
+        raise(A, AERR_NOFND, );
+    Alu_pushbuiltin(A, (alu_Size)index);
+}
+
+/// Removes stack[0] from the stack without releasing it.
+/// The caller takes ownership of the returned value.
+alu_Variable Alu_take(alu_State *A)
+{
+    alu_Variable var = *ALU_STACK_SLOT(A, 0);
+    A->stack.head = (A->stack.head + 1) & (A->stack.cap - 1);
+    --A->stack.len;
+    return var;
+}
+
+/// Pop a value from the stack and return it.
+/// The caller releases it with `Alu_freevar`.
+alu_Variable Alu_pop(alu_State *A)
+{
+    if (A->stack.len == 0)
+        return (alu_Variable){.type = ALU_NULL};
+    return Alu_take(A);
+}
+
+// Get a variable from the stack index.
+alu_Variable *Alu_get(alu_State *A, alu_Size index)
+{
+    if (index >= A->stack.len)
+        raise(A, AERR_NOSTK, null);
+    return ALU_STACK_SLOT(A, index);
+}
+
+/// Get a alu_Number from the Stack, an integer is converted.
+/// `Stack -> Code`
+alu_Number Alu_getnumber(alu_State *A, alu_Size index)
+{
+    alu_Variable *var = Alu_get(A, index);
+    if (var == null)
+        return 0;
+    return ALU_TONUMBER(var);
+}
+
+/// Get a boolean from the stack.
+/// `Stack -> Code`
+_Bool Alu_getbool(alu_State *A, alu_Size index)
+{
+    alu_Variable *var = Alu_get(A, index);
+    if (var == null)
+        return 0;
+    return var->as.boolean;
+}
+
+/// Get a string from the stack.
+/// `Stack -> Code`
+alu_String Alu_getstring(alu_State *A, alu_Size index)
+{
+    alu_Variable *var = Alu_get(A, index);
+    if (var == null)
+        return "";
+    Alu_flattenvar(A, var);
+    if (var->type != ALU_STRING)
+        return "";
+    return var->as.string->chars;
+}
+
+// Returns the sum of the integers `a` and `b`, a double if it leaves
+// the integer range. Integers are too small to overflow the addition.
+static inline alu_Variable __Alu_addint(alu_Integer a, alu_Integer b)
+{
+    alu_Integer res = a + b;
+    if ((uint64_t)(res + ALU_INTEGER_MAX) > (uint64_t)ALU_INTEGER_MAX * 2)
+        return (alu_Variable){.type = ALU_NUMBER, .as.number = (alu_Number)res};
+    return (alu_Variable){.type = ALU_INTEGER, .as.integer = res};
+}
+
+// Returns the sum of the numbers `a` and `b`, an integer only if both
+// are integers.
+static inline alu_Variable __Alu_addnumbers(const alu_Variable *a,
+                                            const alu_Variable *b)
+{
+    if ((a->type == ALU_INTEGER) and (b->type == ALU_INTEGER))
+        return __Alu_addint(a->as.integer, b->as.integer);
+    return (alu_Variable){.type = ALU_NUMBER,
+                          .as.number = ALU_TONUMBER(a) + ALU_TONUMBER(b)};
+}
+
+// Process the sum of 2 variables
+static alu_Variable Alu_sumvar(alu_State *A, alu_Variable *a, alu_Variable *b)
+{
+    alu_Variable res = {.type = a->type};
+    switch (a->type)
+    {
+    case ALU_NUMBER:
+    case ALU_INTEGER:
+        return __Alu_addnumbers(a, b);
+    case ALU_BOOL:
+        res.as.boolean = a->as.boolean + b->as.boolean;
+        break;
+    case ALU_STRING:
+        res.as.string = Alu_concat(A, a->as.string, b->as.string);
+        if (res.as.string == null)
+            return (alu_Variable){.type = ALU_NULL};
+        break;
+    default:
+        return (alu_Variable){.type = ALU_NULL};
+    }
+    return res;
+}
+
+// `Alu_sumstack` without checking the stack length.
+void __Alu_sumstack(alu_State *A)
+{
+    alu_Variable *a = ALU_STACK_SLOT(A, 0), *b = ALU_STACK_SLOT(A, 1);
+    alu_Variable res = {.type = ALU_NULL};
+    _Bool same = ((a->type == b->type) or (ALU_ISNUMBER(a) and ALU_ISNUMBER(b)));
+
+    if (same)
+        res = Alu_sumvar(A, a, b);
+    Alu_stackclose(A);
+    Alu_push(A, res);
+    if (not same)
+        raise(A, AERR_TYPES, );
+}
+
+// `__Alu_sumstack` of two numbers.
+void __Alu_sumnum(alu_State *A)
+{
+    alu_Number res = ALU_STACK_SLOT(A, 0)->as.number +
+                     ALU_STACK_SLOT(A, 1)->as.number;
+    Alu_stackclose(A);
+    Alu_pushnumber(A, res);
+}
+
+// `__Alu_sumstack` of two integers.
+void __Alu_sumint(alu_State *A)
+{
+    alu_Variable res = __Alu_addint(ALU_STACK_SLOT(A, 0)->as.integer,
+                                    ALU_STACK_SLOT(A, 1)->as.integer);
+    Alu_stackclose(A);
+    Alu_push(A, res);
+}
+
+// `__Alu_sumstack` of two strings.
+void __Alu_sumstr(alu_State *A)
+{
+    alu_StringObject *str = Alu_concat(A, ALU_STACK_SLOT(A, 0)->as.string,
+                                       ALU_STACK_SLOT(A, 1)->as.string);
+    Alu_stackclose(A);
+    if (str == null)
+        Alu_push(A, (alu_Variable){.type = ALU_NULL});
+    else
+        Alu_push(A, (alu_Variable){.type = ALU_STRING, .as.string = str});
+}
+
+/// Sum stack[0] and stack[1], empties the stack and pushes the result,
+/// which is null if they can't be summed.
+void Alu_sumstack(alu_State *A)
+{
+    if (A->stack.len < 2)
+        raise(A, AERR_STKLN, );
+    __Alu_sumstack(A);
+}
+
+/**
  *
  * @category Registers methods
  *
@@ -757,271 +1739,1092 @@ void Alu_sumstack(alu_State *A)
 /// `[A, B, C] -> []`
 void Alu_registerclose(alu_State *A)
 {
-    alu_Stack *tmp = null;
-    alu_Register *reg = null;
-    while (A->regs != null)
-    {
-        tmp = A->regs->next;
-        reg = A->regs->data;
-        remove(reg->var->data);
-        remove(reg->var);
-        remove(reg);
-        remove(A->regs);
-        A->regs = tmp;
-    }
+    for (alu_Size n = 0; n < A->nregs; ++n)
+        Alu_freevar(A, &A->regs[n]);
+    remove(A->regs);
+    A->regs = null;
+    A->nregs = 0;
+}
+
+/// Makes sure registers `[0, count)` exist, new ones hold null.
+/// They are reallocated rather than taken from the arena, which would
+/// keep every smaller table when a streamed program grows them.
+_Bool Alu_registerreserve(alu_State *A, alu_Size count)
+{
+    alu_Variable *regs = null;
+    if (count <= A->nregs)
+        return true;
+    regs = (alu_Variable *)realloc(A->regs, sizeof(alu_Variable) * count);
+    if (regs == null)
+        raise(A, AERR_NOMEM, false);
+    memset(regs + A->nregs, 0, sizeof(alu_Variable) * (count - A->nregs));
+    A->regs = regs;
+    A->nregs = count;
+    return true;
+}
+
+// `Alu_load` without checking the stack length and the register index.
+void __Alu_load(alu_State *A, alu_Size registerIndex)
+{
+    Alu_freevar(A, &A->regs[registerIndex]);
+    A->regs[registerIndex] = Alu_take(A);
+    Alu_stackclose(A);
 }
 
 /// Set the value of stack[0] as a deep register.
 /// `Stack -> Deep`
 void Alu_load(alu_State *A, alu_Size registerIndex)
 {
-    alu_Variable *var = null;
-    alu_Register *reg = null;
+    if (A->stack.len < 1)
+        raise(A, AERR_STKLN, );
+    if (registerIndex >= A->nregs)
+        raise(A, AERR_NOREG, );
+    __Alu_load(A, registerIndex);
+}
 
-    if (Stack_len(A->stack) < 1)
-        raise(AERR_STKLN, );
-    var = Alu_cpyvar(A->stack->data);
-    Alu_stackclose(A);
-    for (alu_Stack *r = A->regs; r != null; r = r->next)
-        if (((alu_Register *)r->data)->index == registerIndex)
-        {
-            reg = r->data;
-            remove(reg->var->data);
-            remove(reg->var);
-            break;
-        }
-    if (reg != null)
-    {
-        reg->var = var;
-        return;
-    }
-    reg = (alu_Register *)malloc(sizeof(alu_Register));
-    if (reg == null)
-        raise(AERR_NOMEM, );
-    reg->var = var;
-    reg->index = registerIndex;
-    Stack_push(&A->regs, reg);
+// `Alu_unload` without checking the register index.
+void __Alu_unload(alu_State *A, alu_Size registerIndex)
+{
+    Alu_push(A, Alu_refvar(&A->regs[registerIndex]));
+    if (A->regs[registerIndex].type == ALU_NULL)
+        raise(A, AERR_NOREG, );
 }
 
 /// Get the deep register and push it in the stack.
+/// Pushes null if the register is empty.
 /// `Deep -> Stack`
 void Alu_unload(alu_State *A, alu_Size registerIndex)
 {
-    alu_Variable *var = null;
-    for (alu_Stack *r = A->regs; r != null; r = r->next)
-        if (((alu_Register *)r->data)->index == registerIndex)
-        {
-            var = ((alu_Register *)r->data)->var;
-            break;
-        }
-    if (var == null)
-        raise(AERR_NOREG, );
-    Stack_push(&A->stack, Alu_cpyvar(var));
+    if (registerIndex >= A->nregs)
+    {
+        Alu_push(A, (alu_Variable){.type = ALU_NULL});
+        raise(A, AERR_NOREG, );
+    }
+    __Alu_unload(A, registerIndex);
+}
+
+// `Alu_defunload` without checking the register index.
+void __Alu_defunload(alu_State *A, alu_Size registerIndex)
+{
+    _Bool empty = (A->regs[registerIndex].type == ALU_NULL);
+    Alu_push(A, A->regs[registerIndex]);
+    A->regs[registerIndex] = (alu_Variable){.type = ALU_NULL};
+    if (empty)
+        raise(A, AERR_NOREG, );
 }
 
 /// Time to abandonned register ! (General Grievous)
 ///
 /// Basically removes the register value and push it into
-/// the stack.
+/// the stack, null if it is empty.
 /// `Deep -> Stack`
 void Alu_defunload(alu_State *A, alu_Size registerIndex)
 {
-    alu_Stack *rgStack = null;
-    alu_Variable *var = null;
-    for (alu_Stack *r = A->regs; r != null; r = r->next)
-        if (((alu_Register *)r->data)->index == registerIndex)
+    if (registerIndex >= A->nregs)
+    {
+        Alu_push(A, (alu_Variable){.type = ALU_NULL});
+        raise(A, AERR_NOREG, );
+    }
+    __Alu_defunload(A, registerIndex);
+}
+
+/**
+ *
+ * @category Alu verifier
+ *
+ */
+
+// Number of stack elements `op` reads.
+alu_Size __Alu_stackneed(alu_Opcode op)
+{
+    switch (op)
+    {
+    case OP_SUMSTACK:
+    case OP_EVAL:
+    case OP_SUPER:
+        return 2;
+    case OP_CALL:
+    case OP_LOAD:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Applies the stack effect of `op` to the depth range `d`.
+void __Alu_stackeffect(alu_Opcode op, alu_Depth *d)
+{
+    switch (op)
+    {
+    case OP_PUSHNUM:
+    case OP_PUSHINT:
+    case OP_PUSHSTR:
+    case OP_PUSHBOOL:
+    case OP_PUSHDEF:
+    case OP_UNLOAD:
+    case OP_DEFUNLOAD:
+        d->lo += 1;
+        if (d->hi != ALU_DEPTH_UNBOUNDED)
+            d->hi += 1;
+        break;
+    case OP_SUMSTACK:
+    case OP_EVAL:
+        d->lo = 1;
+        d->hi = 1;
+        break;
+    case OP_STACKCLOSE:
+    case OP_LOAD:
+        d->lo = 0;
+        d->hi = 0;
+        break;
+    case OP_CALL:
+        // A builtin may clear the stack, like `print`.
+        d->lo = 0;
+        if ((d->hi != ALU_DEPTH_UNBOUNDED) and (d->hi != 0))
+            d->hi -= 1;
+        break;
+    case OP_JMP:
+    case OP_JTR:
+    case OP_JFA:
+    case OP_JEM:
+    case OP_JNEM:
+        if (d->lo != 0)
+            d->lo -= 1;
+        if ((d->hi != ALU_DEPTH_UNBOUNDED) and (d->hi != 0))
+            d->hi -= 1;
+        break;
+    default:
+        break;
+    }
+}
+
+// Joins `d` into the depth range of a block.
+// Returns true if the range changed and the block must be visited again.
+_Bool __Alu_mergedepth(alu_Depth *at, alu_Depth d)
+{
+    _Bool changed = false;
+    if (not at->seen)
+    {
+        at->lo = d.lo;
+        at->hi = d.hi;
+        at->seen = true;
+        return true;
+    }
+    if (d.lo < at->lo)
+    {
+        at->lo = d.lo;
+        changed = true;
+    }
+    if (d.hi > at->hi)
+    {
+        at->hi = (++at->grown < ALU_VERIFY_WIDEN ? d.hi : ALU_DEPTH_UNBOUNDED);
+        changed = true;
+    }
+    return changed;
+}
+
+// Marks `pc` as the start of a block.
+static inline void __Alu_markblock(alu_Blocks *b, alu_Size pc)
+{
+    b->marks[pc >> 6] |= (uint64_t)1 << (pc & 63);
+}
+
+// Index of the block starting at `pc`.
+static inline alu_Size __Alu_blockof(const alu_Blocks *b, alu_Size pc)
+{
+    uint64_t below = b->marks[pc >> 6] & (((uint64_t)1 << (pc & 63)) - 1);
+    return b->rank[pc >> 6] + (alu_Size)__builtin_popcountll(below);
+}
+
+// Releases the blocks found by `__Alu_findblocks`.
+void __Alu_freeblocks(alu_Blocks *b)
+{
+    remove(b->starts);
+    remove(b->marks);
+    remove(b->rank);
+    remove(b->depths);
+    *b = (alu_Blocks){0};
+}
+
+// Splits the code in basic blocks, which start at the entry point, the
+// chunks, the jump targets and the instructions after a jump.
+_Bool __Alu_findblocks(alu_State *A, alu_Blocks *b)
+{
+    alu_Size words = A->codelen / 64 + 1, jumps = 0, pc = 0;
+    uint64_t bits = 0;
+
+    *b = (alu_Blocks){0};
+    b->marks = (uint64_t *)calloc(words, sizeof(uint64_t));
+    b->rank = (alu_Size *)malloc(sizeof(alu_Size) * words);
+    if ((b->marks == null) or (b->rank == null))
+    {
+        __Alu_freeblocks(b);
+        raise(A, AERR_NOMEM, false);
+    }
+    __Alu_markblock(b, A->pc);
+    for (alu_Size n = 0; n < A->nchunks; ++n)
+        if (A->chunks[n] < A->codelen)
+            __Alu_markblock(b, A->chunks[n]);
+    for (pc = 0; (jumps < A->njumps) and (pc < A->codelen); ++pc)
+        if ((A->code[pc].op >= OP_JMP) and (A->code[pc].op <= OP_JNEM))
         {
-            var = ((alu_Register *)r->data)->var;
-            break;
+            ++jumps;
+            if (A->code[pc].arg.target <= pc)
+                ++b->loops;
+            if (A->code[pc].arg.target < A->codelen)
+                __Alu_markblock(b, A->code[pc].arg.target);
+            if (pc + 1 < A->codelen)
+                __Alu_markblock(b, pc + 1);
         }
-    if (var == null)
-        raise(AERR_NOREG, );
-    Stack_push(&A->stack, var);
-    rgStack = A->regs;
-    A->regs = A->regs->next;
-    remove(rgStack->data);
-    remove(rgStack);
+    for (alu_Size w = 0; w < words; ++w)
+    {
+        b->rank[w] = b->count;
+        b->count += (alu_Size)__builtin_popcountll(b->marks[w]);
+    }
+    b->starts = (alu_Size *)malloc(sizeof(alu_Size) * b->count);
+    b->depths = (alu_Depth *)calloc(b->count, sizeof(alu_Depth));
+    if ((b->starts == null) or (b->depths == null))
+    {
+        __Alu_freeblocks(b);
+        raise(A, AERR_NOMEM, false);
+    }
+    for (alu_Size w = 0, n = 0; w < words; ++w)
+        for (bits = b->marks[w]; bits != 0; bits &= bits - 1)
+            b->starts[n++] = w * 64 + (alu_Size)__builtin_ctzll(bits);
+    return true;
+}
+
+// First instruction after the block `block`.
+static inline alu_Size __Alu_blockend(alu_State *A, const alu_Blocks *b,
+                                      alu_Size block)
+{
+    return (block + 1 < b->count ? b->starts[block + 1] : A->codelen);
+}
+
+// Proves the stack depth of every instruction reachable from `A->pc`
+// with abstract interpretation over the basic blocks, then checks each
+// reachable instruction against its fixed point and computes the
+// maximum stack depth. `b` gets the blocks and their entry depths, the
+// caller releases them with `__Alu_freeblocks`.
+// Returns false and sets `A->error` on a malformed program: a register
+// out of the table or an instruction that underflows on every path.
+_Bool __Alu_analyze(alu_State *A, alu_Blocks *b)
+{
+    alu_Size *work = null;
+    alu_Size nwork = 0;
+    alu_Size block = 0, pc = 0, end = 0;
+    alu_Size next[2];
+    alu_Size nnext = 0;
+    alu_Depth d;
+    const alu_Instruction *ins = null;
+    _Bool proven = true;
+    alu_Errno failure = AERR_IDK;
+
+    A->verified = false;
+    A->maxdepth = 0;
+    if (not __Alu_findblocks(A, b))
+        return false;
+    work = (alu_Size *)malloc(sizeof(alu_Size) * b->count);
+    if (work == null)
+    {
+        __Alu_freeblocks(b);
+        raise(A, AERR_NOMEM, false);
+    }
+    block = __Alu_blockof(b, A->pc);
+    __Alu_mergedepth(&b->depths[block], (alu_Depth){0});
+    b->depths[block].queued = true;
+    work[nwork++] = block;
+    while (nwork != 0)
+    {
+        block = work[--nwork];
+        b->depths[block].queued = false;
+        d = b->depths[block];
+        end = __Alu_blockend(A, b, block);
+        nnext = 0;
+        for (pc = b->starts[block]; pc < end; ++pc)
+        {
+            ins = &A->code[pc];
+            __Alu_stackeffect(ins->op, &d);
+            if ((ins->op == OP_HALT) or (ins->op == OP_RET) or
+                (ins->op == OP_YIELD))
+                break;
+            if ((ins->op >= OP_JMP) and (ins->op <= OP_JNEM))
+            {
+                if (ins->arg.target < A->codelen)
+                    next[nnext++] = __Alu_blockof(b, ins->arg.target);
+                if (ins->op == OP_JMP)
+                    break;
+            }
+        }
+        if ((pc == end) and (end < A->codelen))
+            next[nnext++] = block + 1;
+        while (nnext != 0)
+        {
+            block = next[--nnext];
+            if (__Alu_mergedepth(&b->depths[block], d) and
+                not b->depths[block].queued)
+            {
+                b->depths[block].queued = true;
+                work[nwork++] = block;
+            }
+        }
+    }
+    free(work);
+    for (block = 0; (block < b->count) and (failure == AERR_IDK); ++block)
+    {
+        d = b->depths[block];
+        end = __Alu_blockend(A, b, block);
+        for (pc = b->starts[block]; d.seen and (pc < end); ++pc)
+        {
+            ins = &A->code[pc];
+            if (d.hi < __Alu_stackneed(ins->op))
+            {
+                A->error = "Stack underflow";
+                failure = AERR_STKLN;
+                break;
+            }
+            if (d.lo < __Alu_stackneed(ins->op))
+                proven = false;
+            if ((ins->op >= OP_LOAD) and (ins->op <= OP_DEFUNLOAD) and
+                (ins->arg.size >= A->nregs))
+            {
+                A->error = "No such register";
+                failure = AERR_NOREG;
+                break;
+            }
+            __Alu_stackeffect(ins->op, &d);
+            if (d.hi > A->maxdepth)
+                A->maxdepth = d.hi;
+            if ((ins->op == OP_HALT) or (ins->op == OP_RET) or
+                (ins->op == OP_YIELD) or (ins->op == OP_JMP))
+                break;
+        }
+    }
+    if (failure != AERR_IDK)
+    {
+        __Alu_freeblocks(b);
+        raise(A, failure, false);
+    }
+    A->verified = proven and (A->maxdepth != ALU_DEPTH_UNBOUNDED);
+    debug(A, "Verified %d, max depth %u\n", A->verified, A->maxdepth);
+    return true;
+}
+
+// Checks the program with `__Alu_analyze`.
+// `A->verified` is set when no instruction can underflow and the depth
+// is bounded, the executor then skips the stack checks.
+_Bool Alu_verify(alu_State *A)
+{
+    alu_Blocks blocks;
+
+    A->verified = false;
+    A->maxdepth = 0;
+    if (A->pc >= A->codelen)
+        return true;
+    if (not __Alu_analyze(A, &blocks))
+        return false;
+    __Alu_freeblocks(&blocks);
+    return true;
+}
+
+/**
+ *
+ * @category Alu optimizer
+ *
+ */
+
+// Returns true if `op` pushes a constant without any other effect.
+static inline _Bool __Alu_ispure(alu_Opcode op)
+{
+    return ((op >= OP_PUSHNUM) and (op <= OP_PUSHDEF)) or (op == OP_PUSHINT);
+}
+
+// Returns the number pushed by the `OP_PUSHNUM` or `OP_PUSHINT` `ins`.
+static inline alu_Variable __Alu_numoperand(const alu_Instruction *ins)
+{
+    if (ins->op == OP_PUSHINT)
+        return (alu_Variable){.type = ALU_INTEGER, .as.integer = ins->arg.integer};
+    return (alu_Variable){.type = ALU_NUMBER, .as.number = ins->arg.number};
+}
+
+// Pushes the constant of the instruction `ins`.
+void __Alu_pushoperand(alu_State *A, const alu_Instruction *ins)
+{
+    if ((ins->op == OP_PUSHNUM) or (ins->op == OP_PUSHINT))
+        Alu_push(A, __Alu_numoperand(ins));
+    else if (ins->op == OP_PUSHSTR)
+        Alu_pushconstant(A, ins->arg.string);
+    else
+        Alu_pushbool(A, ins->arg.byte);
+}
+
+// Folds `ins[0]`, `ins[1]` and the `OP_SUMSTACK` or `OP_EVAL` in `ins[2]`
+// into a single push in `ins[0]`, by running them on the empty stack.
+// Returns false if they are not constants of the same type.
+_Bool __Alu_fold(alu_State *A, alu_Instruction *ins)
+{
+    alu_Variable *res = null;
+    alu_StringObject *str = null;
+
+    if ((ins[0].op != ins[1].op) or
+        ((ins[0].op != OP_PUSHNUM) and (ins[0].op != OP_PUSHINT) and
+         (ins[0].op != OP_PUSHSTR) and (ins[0].op != OP_PUSHBOOL)) or
+        ((ins[2].op != OP_SUMSTACK) and (ins[2].op != OP_EVAL)) or
+        (A->stack.len != 0))
+        return false;
+    __Alu_pushoperand(A, &ins[0]);
+    __Alu_pushoperand(A, &ins[1]);
+    if (A->stack.len != 2)
+    {
+        Alu_stackclose(A);
+        return false;
+    }
+    if (ins[2].op == OP_SUMSTACK)
+        __Alu_sumstack(A);
+    else
+        __Alu_eval(A, ins[2].arg.byte);
+    res = ALU_STACK_SLOT(A, 0);
+    Alu_flattenvar(A, res);
+    if (res->type == ALU_NUMBER)
+        ins[0] = (alu_Instruction){.op = OP_PUSHNUM, .arg.number = res->as.number};
+    else if (res->type == ALU_INTEGER)
+        ins[0] = (alu_Instruction){.op = OP_PUSHINT, .arg.integer = res->as.integer};
+    else if (res->type == ALU_BOOL)
+        ins[0] = (alu_Instruction){.op = OP_PUSHBOOL, .arg.byte = res->as.boolean};
+    else if ((res->type == ALU_STRING) and
+             not (res->as.string->flags & ALU_STR_ROPE) and
+             ((str = Alu_intern(A, res->as.string->chars,
+                                res->as.string->len)) != null))
+        ins[0] = (alu_Instruction){.op = OP_PUSHSTR, .arg.string = str};
+    else
+    {
+        Alu_stackclose(A);
+        return false;
+    }
+    Alu_stackclose(A);
+    return true;
+}
+
+// Makes the jump of `ins` skip the `OP_JMP` it lands on, when the stack
+// is empty once it popped and the skipped jumps pop nothing.
+void __Alu_threadjump(alu_State *A, alu_Instruction *ins, alu_Depth d)
+{
+    alu_Size target = ins->arg.target;
+    if (d.hi > 1)
+        return;
+    for (alu_Size hops = 0; (hops < A->njumps) and (target < A->codelen) and
+                            (A->code[target].op == OP_JMP);
+         ++hops)
+        target = A->code[target].arg.target;
+    ins->arg.target = target;
+}
+
+// Rewrites the code of `blocks` in place: folds constant sums and
+// comparisons on the empty stack, removes the pushes a `OP_STACKCLOSE`
+// drops and the `OP_STACKCLOSE` of an empty stack, and threads jumps to
+// jumps. No instruction moves across a block start.
+// Returns the number of eliminated instructions, -1 without memory.
+long __Alu_peephole(alu_State *A, alu_Blocks *blocks)
+{
+    alu_Size *starts = null;
+    alu_Depth d;
+    alu_Size pc = 0, end = 0, w = 0, zero = 0, eliminated = 0;
+    alu_Instruction ins;
+
+    starts = (alu_Size *)malloc(sizeof(alu_Size) * blocks->count);
+    if (starts == null)
+        raise(A, AERR_NOMEM, -1);
+    for (alu_Size block = 0; block < blocks->count; ++block)
+    {
+        d = blocks->depths[block];
+        end = __Alu_blockend(A, blocks, block);
+        for (pc = blocks->starts[block]; d.seen and (pc < end); ++pc)
+        {
+            if ((A->code[pc].op >= OP_JMP) and (A->code[pc].op <= OP_JNEM))
+                __Alu_threadjump(A, &A->code[pc], d);
+            __Alu_stackeffect(A->code[pc].op, &d);
+        }
+    }
+    for (alu_Size block = 0; block < blocks->count; ++block)
+    {
+        d = blocks->depths[block];
+        if (not d.seen)
+            d = (alu_Depth){.lo = 0, .hi = ALU_DEPTH_UNBOUNDED};
+        end = __Alu_blockend(A, blocks, block);
+        starts[block] = w;
+        zero = ALU_DEPTH_UNBOUNDED;
+        for (pc = blocks->starts[block]; pc < end; ++pc)
+        {
+            ins = A->code[pc];
+            if ((d.lo == 0) and (d.hi == 0))
+                zero = w;
+            __Alu_stackeffect(ins.op, &d);
+            if (ins.op == OP_STACKCLOSE)
+            {
+                while ((w > starts[block]) and __Alu_ispure(A->code[w - 1].op))
+                    --w;
+                if (w == zero)
+                    continue;
+            }
+            A->code[w++] = ins;
+            if ((zero != ALU_DEPTH_UNBOUNDED) and (zero + 3 == w) and
+                __Alu_fold(A, &A->code[zero]))
+                w -= 2;
+        }
+    }
+    for (pc = 0; pc < w; ++pc)
+        if ((A->code[pc].op >= OP_JMP) and (A->code[pc].op <= OP_JNEM))
+            A->code[pc].arg.target =
+                (A->code[pc].arg.target < A->codelen
+                     ? starts[__Alu_blockof(blocks, A->code[pc].arg.target)]
+                     : w);
+    A->pc = starts[__Alu_blockof(blocks, A->pc)];
+    for (alu_Size n = 0; n < A->nchunks; ++n)
+        A->chunks[n] = (A->chunks[n] < A->codelen
+                            ? starts[__Alu_blockof(blocks, A->chunks[n])]
+                            : w);
+    A->code[w].op = OP_HALT;
+    eliminated = A->codelen - w;
+    A->codelen = w;
+    free(starts);
+    return (long)eliminated;
+}
+
+// Rewrites the frequent sequences of `blocks` into superinstructions,
+// for the `ALU_FUSE_` flags set in `A->fuse`. The fused opcode replaces
+// the first instruction of the sequence and its handler reads the
+// operands of the others in place, then skips them, so no instruction
+// moves. Sequences never span a block start and are only fused where
+// the depth proves the stack checks of their instructions useless, so
+// the program must be proven by `Alu_verify`.
+// Returns the number of superinstructions.
+alu_Size __Alu_fuse(alu_State *A, alu_Blocks *blocks)
+{
+    alu_Instruction *ins = null;
+    alu_Depth d;
+    alu_Size pc = 0, end = 0, fused = 0;
+
+    for (alu_Size block = 0; block < blocks->count; ++block)
+    {
+        d = blocks->depths[block];
+        end = __Alu_blockend(A, blocks, block);
+        for (pc = blocks->starts[block]; d.seen and (pc < end); ++pc)
+        {
+            ins = &A->code[pc];
+            if ((A->fuse & ALU_FUSE_CALLDEF) and (pc + 2 < end) and
+                (ins[0].op == OP_PUSHDEF) and (ins[1].op == OP_SUPER) and
+                (ins[2].op == OP_CALL) and (d.lo >= 1))
+            {
+                ins->op = OP_CALLDEF;
+                d.lo = 0;
+                pc += 2;
+                ++fused;
+                continue;
+            }
+            if ((A->fuse & ALU_FUSE_ADDREG) and (pc + 3 < end) and
+                (ins[0].op == OP_UNLOAD) and
+                ((ins[1].op == OP_PUSHNUM) or (ins[1].op == OP_PUSHINT)) and
+                (ins[2].op == OP_SUMSTACK) and (ins[3].op == OP_LOAD) and
+                (d.hi == 0))
+            {
+                ins->op = OP_ADDREG;
+                pc += 3;
+                ++fused;
+                continue;
+            }
+            if ((pc + 1 < end) and (ins[0].op == OP_EVAL) and (d.lo >= 2) and
+                (((A->fuse & ALU_FUSE_EVALJFA) and (ins[1].op == OP_JFA)) or
+                 ((A->fuse & ALU_FUSE_EVALJTR) and (ins[1].op == OP_JTR))))
+            {
+                // The jump ends the block.
+                ins->op = (ins[1].op == OP_JFA ? OP_EVALJFA : OP_EVALJTR);
+                ++fused;
+                break;
+            }
+            __Alu_stackeffect(ins->op, &d);
+        }
+    }
+    debug(A, "Optimizer fused %u superinstructions\n", fused);
+    return fused;
+}
+
+// Optimizer run between the loading and the execution, on the blocks
+// and depths found by `__Alu_analyze`. Code without a backward jump runs
+// each instruction once at most, `__Alu_peephole` is skipped there
+// since it would cost more than it saves. Superinstructions are fused
+// last, once the program is verified, as the verifier does not know
+// them.
+// Returns the number of eliminated instructions, -1 on a malformed
+// program.
+long Alu_optimize(alu_State *A)
+{
+    alu_Blocks blocks;
+    long eliminated = 0;
+
+    A->verified = false;
+    A->maxdepth = 0;
+    if (A->pc >= A->codelen)
+        return 0;
+    if (not __Alu_analyze(A, &blocks))
+        return -1;
+    if (blocks.loops != 0)
+        eliminated = __Alu_peephole(A, &blocks);
+    debug(A, "Optimizer eliminated %ld instructions\n", eliminated);
+    if (eliminated != 0)
+    {
+        __Alu_freeblocks(&blocks);
+        if ((eliminated < 0) or not __Alu_analyze(A, &blocks))
+            return -1;
+    }
+    if ((A->fuse != 0) and A->verified)
+        __Alu_fuse(A, &blocks);
+    __Alu_freeblocks(&blocks);
+    return eliminated;
+}
+
+/**
+ *
+ * @category Alu methods
+ *
+ */
+
+static alu_Size __Alu_seedgen(alu_State *A)
+{
+    size_t bigseed = 0;
+    bigseed += (size_t)&A + (size_t)time(NULL) + (size_t)&__Alu_seedgen;
+    return (alu_Size)bigseed;
+}
+
+// Creates an `alu_State`.
+alu_State *Alu_newstate(void)
+{
+    alu_State *A = (alu_State *)malloc(sizeof(alu_State));
+    if (A == null)
+        raise(null, AERR_NOMEM, null);
+    memset(A, 0, sizeof(alu_State));
+    signal(SIGINT, __Alu_sighandler);
+    A->out.fd = STDOUT_FILENO;
+    A->seed = __Alu_seedgen(A);
+    A->fuse = ALU_FUSE_DEFAULT;
+    return A;
+}
+
+/// Close an `alu_State`.
+/// Returns the status code.
+int Alu_close(alu_State *A)
+{
+    int res = 0;
+    if (A == null)
+        return 1;
+    Alu_flush(A);
+    if (A->error or res)
+    {
+        fprintf(stderr,
+                "| [ERROR] Program ends with an error:\n| %s\n", A->error);
+        res = 1;
+    }
+#if ALU_PROFILE
+    for (int op = 0; op < OP_COUNT; ++op)
+        if (A->profile[op] != 0)
+            fprintf(stderr, "| [PROFILE] %-10s %llu\n", OPNAMES[op],
+                    (unsigned long long)A->profile[op]);
+#endif
+    Alu_stackclose(A);
+    remove(A->stack.slots);
+    Alu_registerclose(A);
+    remove(A->code);
+    Alu_arenaclose(A);
+    remove(A->out.buf);
+    remove(A);
+    return res;
+}
+
+// Returns the `EVAL_` flag of the sign of `cmpres`.
+alu_Byte __Alu_evalflag(int cmpres)
+{
+    return ((cmpres == 0) ? EVAL_EQUALS
+                          : ((cmpres < 0) ? EVAL_SMALLER : EVAL_GREATER));
+}
+
+// Returns true if `num` is a NaN. It is read from the bits, since the
+// floating point compares assume there is none with `-Ofast`.
+static inline _Bool __Alu_isnan(alu_Number num)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, &num, sizeof(bits));
+    return (bits << 1) > (0x7ffull << 53);
+}
+
+// Compares the numbers `a` and `b` with `eval`.
+// They are compared as they are, a NaN matches no flag.
+_Bool __Alu_comparenum(alu_Number a, alu_Number b, alu_Byte eval)
+{
+    if (__Alu_isnan(a) or __Alu_isnan(b))
+        return false;
+    if (a < b)
+        return (eval & EVAL_SMALLER) != 0;
+    if (a > b)
+        return (eval & EVAL_GREATER) != 0;
+    return (eval & EVAL_EQUALS) != 0;
+}
+
+// Compares the integers `a` and `b` with `eval`.
+_Bool __Alu_compareint(alu_Integer a, alu_Integer b, alu_Byte eval)
+{
+    if (a < b)
+        return (eval & EVAL_SMALLER) != 0;
+    if (a > b)
+        return (eval & EVAL_GREATER) != 0;
+    return (eval & EVAL_EQUALS) != 0;
+}
+
+// Tests with `eval` values compared only for their equality. Both order
+// flags together mean "not equal", a single one never holds since the
+// values have no order.
+_Bool __Alu_compareequal(_Bool equal, alu_Byte eval)
+{
+    if (equal)
+        return (eval & EVAL_EQUALS) != 0;
+    return (eval & (EVAL_SMALLER | EVAL_GREATER)) ==
+           (EVAL_SMALLER | EVAL_GREATER);
+}
+
+// Compares the strings of `a` and `b` with `eval`, flattening them.
+// Without an order flag, or with both, only their equality is tested.
+_Bool __Alu_comparestr(alu_State *A, alu_Variable *a, alu_Variable *b,
+                       alu_Byte eval)
+{
+    Alu_flattenvar(A, a);
+    Alu_flattenvar(A, b);
+    if (a->type != b->type)
+        return false;
+    if (a->type != ALU_STRING)
+        return (eval & EVAL_EQUALS) != 0;
+    if (((eval & EVAL_SMALLER) == 0) == ((eval & EVAL_GREATER) == 0))
+        return __Alu_compareequal(Alu_streq(a->as.string, b->as.string),
+                                  eval);
+    return (__Alu_evalflag(Alu_strcmp(a->as.string, b->as.string)) & eval) != 0;
+}
+
+// Compares stack[0] and stack[1] with `eval` and empties the stack,
+// without checking its length.
+// Values of different types are never equal, null and C pointers are
+// only equal to themselves and have no order.
+_Bool __Alu_compare(alu_State *A, alu_Byte eval)
+{
+    alu_Variable *a = ALU_STACK_SLOT(A, 0), *b = ALU_STACK_SLOT(A, 1);
+    _Bool res = false;
+
+    if (a->type != b->type)
+        res = (ALU_ISNUMBER(a) and ALU_ISNUMBER(b) and
+               __Alu_comparenum(ALU_TONUMBER(a), ALU_TONUMBER(b), eval));
+    else if (a->type == ALU_INTEGER)
+        res = __Alu_compareint(a->as.integer, b->as.integer, eval);
+    else if (a->type == ALU_NUMBER)
+        res = __Alu_comparenum(a->as.number, b->as.number, eval);
+    else if (a->type == ALU_STRING)
+        res = __Alu_comparestr(A, a, b, eval);
+    else if (a->type == ALU_BOOL)
+        res = (__Alu_evalflag(a->as.boolean - b->as.boolean) & eval) != 0;
+    else
+        res = __Alu_compareequal(a->as.abstract == b->as.abstract, eval);
+    Alu_stackclose(A);
+    return res;
+}
+
+// `Alu_eval` without checking the stack length.
+void __Alu_eval(alu_State *A, alu_Byte eval)
+{
+    Alu_pushbool(A, __Alu_compare(A, eval));
+}
+
+// `__Alu_eval` of two numbers.
+void __Alu_evalnum(alu_State *A, alu_Byte eval)
+{
+    _Bool res = __Alu_comparenum(ALU_STACK_SLOT(A, 0)->as.number,
+                                 ALU_STACK_SLOT(A, 1)->as.number, eval);
+    Alu_stackclose(A);
+    Alu_pushbool(A, res);
 }
 
-/**
- *
- * @category Alu methods
- *
- */
+// `__Alu_eval` of two integers.
+void __Alu_evalint(alu_State *A, alu_Byte eval)
+{
+    _Bool res = __Alu_compareint(ALU_STACK_SLOT(A, 0)->as.integer,
+                                 ALU_STACK_SLOT(A, 1)->as.integer, eval);
+    Alu_stackclose(A);
+    Alu_pushbool(A, res);
+}
 
-static alu_Size __Alu_seedgen(alu_State *A)
+// `__Alu_eval` of two strings.
+void __Alu_evalstr(alu_State *A, alu_Byte eval)
 {
-    size_t bigseed = 0;
-    bigseed += (size_t)&A + (size_t)time(NULL) + (size_t)&__Alu_seedgen;
-    return (alu_Size)bigseed;
+    _Bool res = __Alu_comparestr(A, ALU_STACK_SLOT(A, 0),
+                                 ALU_STACK_SLOT(A, 1), eval);
+    Alu_stackclose(A);
+    Alu_pushbool(A, res);
 }
 
-// Creates an `alu_State`.
-alu_State *Alu_newstate(void)
+/// Evaluate stack[0] and stack[1] and compared with eval.
+/// Pushes true or false in the stack.
+void Alu_eval(alu_State *A, alu_Byte eval)
 {
-    alu_State *A = (alu_State *)malloc(sizeof(alu_State));
-    if (A == null)
-        raise(AERR_NOMEM, null);
-    memset(A, 0, sizeof(alu_State));
-    signal(SIGINT, __Alu_sighandler);
-    A->seed = __Alu_seedgen(A);
-    return A;
+    if (A->stack.len < 2)
+        raise(A, AERR_STKLN, );
+    __Alu_eval(A, eval);
 }
 
-// Clears the garbage.
-void Alu_garbageclose(alu_State *A)
+/// Returns the number of bytes there is from the OP code to the end
+/// of an instruction.
+size_t __Alu_readop(alu_State *A, alu_Opcode op, const char *ptr, size_t left)
 {
-    alu_Stack *tmp = null;
-    alu_Variable *var = null;
-    while (A->garbage != null)
+    size_t size = 1;
+    _Bool integer = (((op >= OP_JMP) and (op <= OP_JNEM)) or
+                     (F[op].argument == 1) or (F[op].argument == 5) or
+                     ((F[op].argument == 3) and (A->consts != null)));
+
+    if (integer and A->varint)
+    {
+        while ((size < left) and (ptr[size] & 0x80))
+            ++size;
+        return size;
+    }
+    if (integer)
+        return sizeof(alu_Size);
+    switch (F[op].argument)
     {
-        tmp = A->garbage->next;
-        var = A->garbage->data;
-        if (var->type != ALU_ABSTRACT and var->type != ALU_NULL)
-            remove(var->data);
-        remove(var);
-        remove(A->garbage);
-        A->garbage = tmp;
+    case 2:
+        return sizeof(alu_Number);
+    case 3:
+        for (size = 0; (size < left) and (ptr[size] != '\0'); ++size)
+            ;
+        return size;
+    case 4:
+        return sizeof(alu_Byte);
+    default:
+        return 0;
     }
 }
 
-/// Close the `instructions`.
-void Alu_instructionclose(alu_State *A)
+/// Resolves the default function `name` of an `OP_PUSHDEF` to its
+/// index in `DEF`.
+_Bool __Alu_decodedef(alu_State *A, const char *name, alu_Instruction *ins)
 {
-    alu_Stack *tmp = null;
-    while (A->instructions != null)
+    long index = __Alu_finddef(name);
+    if (index < 0)
     {
-        tmp = A->instructions->next;
-        remove(A->instructions->data);
-        remove(A->instructions);
-        A->instructions = tmp;
+        A->error = "Unknown default function";
+        raise(A, AERR_NOFND, false);
     }
+    ins->arg.size = (alu_Size)index;
+    return true;
 }
 
-/// Close an `alu_State`.
-/// Returns the status code.
-int Alu_close(alu_State *A)
+/// Decodes the string operand of `ins`, the constant `index`.
+_Bool __Alu_decodeconst(alu_State *A, alu_Size index, alu_Instruction *ins)
 {
-    int res = 0;
-    if (A == null)
-        return 1;
-    if (A->error or res)
+    if (index >= A->nconsts)
     {
-        fprintf(stderr,
-                "| [ERROR] Program ends with an error:\n| %s\n", A->error);
-        res = 1;
+        A->error = "Unknown constant";
+        raise(A, AERR_NOFND, false);
     }
-    Alu_stackclose(A);
-    Alu_garbageclose(A);
-    Alu_instructionclose(A);
-    Alu_registerclose(A);
-    remove(A);
-    return res;
+    if (ins->op == OP_PUSHDEF)
+        return __Alu_decodedef(A, A->consts[index]->chars, ins);
+    ins->arg.string = A->consts[index];
+    return true;
 }
 
-/// Evaluate stack[0] and stack[1] and compared with eval.
-/// Pushes true or false in the stack.
-void Alu_eval(alu_State *A, alu_Byte eval)
+// Reads the integer operand at `raw`, a varint when the program is
+// compact. Returns false if it doesn't fit.
+_Bool __Alu_decodeint(alu_State *A, const alu_Byte *raw, _Bool sign,
+                      int32_t *value)
 {
-    int8_t ev = 0, cmpres = 0;
-    alu_Variable *a = null, *b = null;
-
-    if (Stack_len(A->stack) < 1)
-        raise(AERR_STKLN, );
-    a = Alu_get(A, 0);
-    b = Alu_get(A, 1);
-    if (a->type != b->type)
+    if (not A->varint)
+        *value = (int32_t)bytesint(raw);
+    else if ((sign ? bytessleb(raw, value)
+                   : bytesuleb(raw, (uint32_t *)value)) == 0)
     {
-        Alu_stackclose(A);
-        Alu_pushbool(A, false);
-        return;
+        A->error = "Invalid varint";
+        raise(A, AERR_CREAD, false);
     }
-    if (a->type == ALU_STRING)
-        cmpres = strcmp(a->data, b->data);
-    else
-        cmpres = (*((alu_Number *)a->data) - *((alu_Number *)b->data));
-    ev |= (cmpres == 0) ? EVAL_EQUALS : 0;
-    ev |= ((cmpres < 0) ? EVAL_SMALLER : ((cmpres > 0) ? EVAL_GREATER : 0));
-    Alu_stackclose(A);
-    Alu_pushbool(A, ev & eval);
+    return true;
 }
 
-/// Returns the number of bytes there is from the OP code to the end
-/// of an instruction.
-size_t __Alu_readop(alu_Opcode op, const char *ptr)
+/// Decodes the raw instruction `raw` into `ins`.
+/// Returns false if the operand could not be decoded.
+_Bool __Alu_decodeop(alu_State *A, const alu_Byte *raw, alu_Instruction *ins)
 {
-    size_t size = 0;
-    if ((op >= OP_JMP) and (op <= OP_JNEM))
-        return sizeof(alu_Size);
-    switch (F[op].argument)
+    int32_t value = 0;
+
+    ins->op = raw[0];
+    if ((ins->op >= OP_JMP) and (ins->op <= OP_JNEM))
+    {
+        if (not __Alu_decodeint(A, raw + 1, true, &value))
+            return false;
+        ins->arg.offset = value;
+        return true;
+    }
+    switch (F[ins->op].argument)
     {
     case 1:
-        return sizeof(alu_Size);
+        if (not __Alu_decodeint(A, raw + 1, false, &value))
+            return false;
+        ins->arg.size = (alu_Size)value;
+        break;
     case 2:
-        return sizeof(alu_Number);
+        ins->arg.number = (alu_Number)bytesdouble(raw + 1);
+        break;
     case 3:
-        while (ptr[size] != '\0')
-            ++size;
-        return size;
+        if ((A->consts != null) and
+            not __Alu_decodeint(A, raw + 1, false, &value))
+            return false;
+        if (A->consts != null)
+            return __Alu_decodeconst(A, (alu_Size)value, ins);
+        if (ins->op == OP_PUSHDEF)
+            return __Alu_decodedef(A, (const char *)raw + 1, ins);
+        ins->arg.string = Alu_intern(
+            A, (const char *)raw + 1, strlen((const char *)raw + 1));
+        return ins->arg.string != null;
     case 4:
-        return sizeof(alu_Byte);
+        ins->arg.byte = raw[1];
+        break;
+    case 5:
+        if (not __Alu_decodeint(A, raw + 1, true, &value))
+            return false;
+        ins->arg.integer = value;
+        break;
     default:
-        return 0;
+        break;
     }
+    return true;
 }
 
-/// Feed the state instruction with a raw instruction string.
-void Alu_feed(alu_State *A, const alu_String ptr)
+/// Turns the relative offset of the jump `ins`, found at `pc`, into an
+/// absolute instruction index kept in `farthest` if it is the farthest,
+/// and counts the registers used by `ins` in `nregs`.
+/// Returns false if a jump lands before the chunk being decoded, which
+/// starts at `A->chunkstart`, or if a register index is too big.
+_Bool __Alu_linkop(alu_State *A, alu_Instruction *ins, alu_Size pc,
+                   alu_Size *nregs, long *farthest)
 {
-    alu_Byte op = 0x00;
-    char *str = null;
+    long target = 0;
+    if ((ins->op >= OP_JMP) and (ins->op <= OP_JNEM))
+    {
+        target = (long)pc + ins->arg.offset + (ins->arg.offset > 0 ? 1 : -1);
+        if (target < (long)A->chunkstart)
+        {
+            A->error = "Jump out of the program";
+            raise(A, AERR_OUTJM, false);
+        }
+        ins->arg.target = (alu_Size)target;
+        ++A->njumps;
+        if (target > *farthest)
+            *farthest = target;
+    }
+    else if ((ins->op >= OP_LOAD) and (ins->op <= OP_DEFUNLOAD))
+    {
+        if (ins->arg.size > ALU_MAX_REGISTER)
+        {
+            A->error = "Register index too big";
+            raise(A, AERR_NOREG, false);
+        }
+        if (ins->arg.size >= *nregs)
+            *nregs = ins->arg.size + 1;
+    }
+    return true;
+}
+
+// Makes room for `count` instructions in the code.
+_Bool __Alu_codereserve(alu_State *A, alu_Size count)
+{
+    alu_Instruction *code = null;
+    alu_Size cap = (A->codecap ? A->codecap * 2 : 256);
+    if (count <= A->codecap)
+        return true;
+    if (cap < count)
+        cap = count;
+    code = (alu_Instruction *)realloc(A->code, sizeof(alu_Instruction) * cap);
+    if (code == null)
+        raise(A, AERR_NOMEM, false);
+    A->code = code;
+    A->codecap = cap;
+    return true;
+}
+
+/// Decodes the complete instructions of the `len` bytes at `ptr` after
+/// the code, and sets `halted` if it meets the end of the program.
+///
+/// Every instruction is decoded once into the flat `code` array, which
+/// always ends with an `OP_HALT`, or an `OP_YIELD` while streaming, so
+/// the executor never runs past it. Jumps are resolved and registers
+/// counted in the same pass. While streaming, jumps may land after the
+/// code decoded so far.
+/// Returns the number of bytes decoded, or -1 on error.
+long __Alu_decode(alu_State *A, const char *ptr, size_t len, _Bool *halted)
+{
+    alu_Size nregs = A->nregs;
+    long farthest = A->farthest;
     size_t n = 0, readlen = 0;
+    alu_Byte op = 0x00;
+    _Bool ok = true;
+
     debug(A, "=== Begin of instructions ===\n");
-    do
+    for (n = 0; n < len; n += readlen + 1)
     {
         op = (alu_Byte)ptr[n];
-        if ((op == OP_HALT) or (op > OP_END))
+        if ((op == OP_HALT) or (op >= OP_END))
+        {
+            *halted = true;
             break;
-        readlen = __Alu_readop(op, &ptr[n]);
-        str = strcut(ptr, n, n + readlen + 1);
-        if (str == null)
+        }
+        readlen = __Alu_readop(A, op, &ptr[n], len - n);
+        if (n + readlen + 1 > len)
+            break;
+        if (A->verbose)
+        {
+            debug(A, "Get: ");
+            for (size_t i = 0; i <= readlen; ++i)
+                debug(A, "%02x ", (alu_Byte)ptr[n + i]);
+            debug(A, "\n");
+        }
+        if (not (ok = __Alu_codereserve(A, A->codelen + 2) and
+                      __Alu_decodeop(A, (const alu_Byte *)&ptr[n],
+                                     &A->code[A->codelen]) and
+                      __Alu_linkop(A, &A->code[A->codelen], A->codelen,
+                                   &nregs, &farthest)))
             break;
-        n += readlen + 1;
-        debug(A, "Get: ");
-        for (size_t i = 0; i <= readlen; ++i)
-            debug(A, "%02x ", str[i]);
-        debug(A, "\n");
-        Stack_push(&A->instructions, str);
-    } while (true);
+        ++A->codelen;
+    }
+    if (not __Alu_codereserve(A, A->codelen + 1))
+        return -1;
+    A->code[A->codelen].op = (A->streaming ? OP_YIELD : OP_HALT);
+    A->farthest = farthest;
     debug(A, "Get: 00\n===  End of instructions  ===\n\n");
+    if (ok and (farthest >= (long)A->codelen) and not A->streaming)
+    {
+        A->error = "Jump out of the program";
+        raise(A, AERR_OUTJM, -1);
+    }
+    if (not ok or not Alu_registerreserve(A, nregs))
+        return -1;
+    return (long)n;
 }
 
-// Execute the opcode instruction.
-void __Alu_executeop(alu_State *A, alu_Opcode op, const alu_Byte *instructions)
+/// Feed the state instruction with `len` bytes of raw instructions.
+/// Decoding stops at the first `OP_HALT` or at the end of the bytes.
+/// Returns false if the instructions can't be executed.
+_Bool Alu_feed(alu_State *A, const char *ptr, size_t len)
 {
-    alu_String str = null;
-    switch (F[op].argument)
+    _Bool halted = false;
+    long used = __Alu_decode(A, ptr, len, &halted);
+    if (used < 0)
+        return false;
+    if (not halted and ((size_t)used != len))
     {
-    case 0: // A
-        ((func0_t)F[op].func)(A);
-        break;
-    case 1: // A, alu_Size
-        ((func1_t)F[op].func)(A, (alu_Size)bytesint(instructions + 1));
-        break;
-    case 2: // A, alu_Number
-        ((func2_t)F[op].func)(A, (alu_Number)bytesdouble(instructions + 1));
-        break;
-    case 3: // A, alu_String
-        str = strcut(
-            (char *)instructions, 1, strlen((char *)instructions + 1) + 1);
-        ((func3_t)F[op].func)(A, str);
-        remove(str);
-        break;
-    case 4:
-        ((func4_t)F[op].func)(A, *(instructions + 1));
-    default:
-        break;
+        A->error = "Truncated instruction";
+        raise(A, AERR_CREAD, false);
     }
+    return true;
 }
 
 // Returns true if the jump instruction is valid.
@@ -1031,104 +2834,657 @@ _Bool __Alu_needtojump(alu_State *A, alu_Opcode op)
 
     if (op == OP_JMP)
         return true;
-    if (A->stack == null and op == OP_JEM)
+    if (A->stack.len == 0 and op == OP_JEM)
         return true;
-    if (A->stack == null)
+    if (A->stack.len == 0)
         return false;
-    var = ((alu_Variable *)A->stack->data);
+    var = Alu_get(A, 0);
     switch (op)
     {
     case OP_JFA:
-        return (var->type == ALU_BOOL) and (*((_Bool *)var->data) == false);
+        return (var->type == ALU_BOOL) and (var->as.boolean == false);
     case OP_JTR:
-        return (var->type == ALU_BOOL) and (*((_Bool *)var->data) == true);
+        return (var->type == ALU_BOOL) and (var->as.boolean == true);
     default:
         return true;
     }
 }
 
 // Execute an OP_JUMP action.
-void Alu_jump(alu_State *A, alu_Opcode op, alu_Stack **iptr)
+// Returns the index of the next instruction to execute.
+alu_Size Alu_jump(alu_State *A, alu_Size pc)
 {
-    if (not __Alu_needtojump(A, op))
+    const alu_Instruction *ins = &A->code[pc];
+    if (not __Alu_needtojump(A, ins->op))
     {
         debug(A, "Dont jump\n");
-        *iptr = (*iptr)->next;
         Alu_popk(A);
-        return;
+        return pc + 1;
     }
-    int jumps = bytesint(((alu_Byte *)(*iptr)->data) + 1);
-    jumps += (jumps > 0 ? 1 : -1);
-    debug(A, "Jump %d instructions\n", jumps);
+    debug(A, "Jump to %d\n", ins->arg.target);
     Alu_popk(A);
-    if (jumps >= 0)
-        for (; jumps-- and (*iptr != null); *iptr = (*iptr)->next)
-            ;
-    else
-        for (; jumps++ and (*iptr != null); *iptr = (*iptr)->previous)
-            debug(A, "> %p\n", (*iptr)->previous);
-    if (*iptr == null)
-        raise(AERR_OUTJM, );
+    return ins->arg.target;
 }
 
-// Executes the instruction set.
-void Alu_execute(alu_State *A)
+// Stops the execution at `pc`, after the decoded code.
+// Returns true if it only pauses until more of the streamed program is
+// decoded. Reaching the end of the code halts, going past it is an error.
+_Bool __Alu_jumpout(alu_State *A, alu_Size pc)
 {
-    alu_Stack *instruction = A->instructions;
-    alu_Byte op = 0x00;
-    while ((instruction != null) and (not errno))
+    A->pc = pc;
+    if (A->streaming or (pc == A->codelen))
+        return A->streaming;
+    A->error = "Jump out of the program";
+    raise(A, AERR_OUTJM, false);
+}
+
+#if ALU_PROFILE
+#define VM_COUNT() (++A->profile[ip->op])
+#else
+#define VM_COUNT() ((void)0)
+#endif
+
+#if ALU_THREADED
+#define VM_TARGET(op) TARGET_##op:
+#define VM_CHECKED(op) CHECKED_##op:
+#define VM_DISPATCH()                           \
+    {                                           \
+        debug(A, "Executes %02x\n", ip->op);    \
+        VM_COUNT();                             \
+        goto *targets[ip->op];                  \
+    }
+#else
+#define VM_TARGET(op) case op:
+#define VM_CHECKED(op) \
+    case op:           \
+        if (verified)  \
+            goto TARGET_##op;
+#define VM_DISPATCH()                           \
+    {                                           \
+        debug(A, "Executes %02x\n", ip->op);    \
+        VM_COUNT();                             \
+        continue;                               \
+    }
+#endif
+
+// Entry of an instruction that skips the stack checks.
+#define VM_FAST(op) TARGET_##op:
+
+#define VM_NEXT()      \
+    {                  \
+        ++ip;          \
+        VM_DISPATCH(); \
+    }
+
+// Rewrites a quickened instruction back to `generic` and runs it.
+#define VM_DEQUICKEN(generic) \
+    {                         \
+        ip->op = generic;     \
+        VM_DISPATCH();        \
+    }
+
+// Dispatch table, `CHECK` is `CHECKED_` or `TARGET_` for the
+// instructions whose stack length is proven by `Alu_verify`.
+#define VM_TABLE(CHECK)                            \
+    {                                              \
+        [OP_HALT] = &&TARGET_OP_HALT,              \
+        [OP_RET] = &&TARGET_OP_RET,                \
+        [OP_JMP] = &&TARGET_OP_JMP,                \
+        [OP_JTR] = &&TARGET_OP_JTR,                \
+        [OP_JFA] = &&TARGET_OP_JFA,                \
+        [OP_JEM] = &&TARGET_OP_JEM,                \
+        [OP_JNEM] = &&TARGET_OP_JNEM,              \
+        [OP_PUSHNUM] = &&TARGET_OP_PUSHNUM,        \
+        [OP_PUSHSTR] = &&TARGET_OP_PUSHSTR,        \
+        [OP_PUSHBOOL] = &&TARGET_OP_PUSHBOOL,      \
+        [OP_PUSHDEF] = &&TARGET_OP_PUSHDEF,        \
+        [OP_SUMSTACK] = &&CHECK##OP_SUMSTACK,      \
+        [OP_STACKCLOSE] = &&TARGET_OP_STACKCLOSE,  \
+        [OP_EVAL] = &&CHECK##OP_EVAL,              \
+        [OP_SUPER] = &&CHECK##OP_SUPER,            \
+        [OP_CALL] = &&CHECK##OP_CALL,              \
+        [OP_LOAD] = &&CHECK##OP_LOAD,              \
+        [OP_UNLOAD] = &&CHECK##OP_UNLOAD,          \
+        [OP_DEFUNLOAD] = &&CHECK##OP_DEFUNLOAD,    \
+        [OP_YIELD] = &&TARGET_OP_YIELD,            \
+        [OP_CALLDEF] = &&TARGET_OP_CALLDEF,        \
+        [OP_ADDREG] = &&TARGET_OP_ADDREG,          \
+        [OP_EVALJFA] = &&TARGET_OP_EVALJFA,        \
+        [OP_EVALJTR] = &&TARGET_OP_EVALJTR,        \
+        [OP_SUMNUM] = &&TARGET_OP_SUMNUM,          \
+        [OP_SUMSTR] = &&TARGET_OP_SUMSTR,          \
+        [OP_EVALNUM] = &&TARGET_OP_EVALNUM,        \
+        [OP_EVALSTR] = &&TARGET_OP_EVALSTR,        \
+        [OP_SUMINT] = &&TARGET_OP_SUMINT,          \
+        [OP_EVALINT] = &&TARGET_OP_EVALINT,        \
+        [OP_PUSHINT] = &&TARGET_OP_PUSHINT,        \
+    }
+
+// Whether stack[0] and stack[1] both hold a `type`.
+_Bool __Alu_stackis(alu_State *A, alu_Type type)
+{
+    return ((A->stack.len >= 2) and (ALU_STACK_SLOT(A, 0)->type == type) and
+            (ALU_STACK_SLOT(A, 1)->type == type));
+}
+
+// Rewrites the `OP_SUMSTACK` or `OP_EVAL` at `ins` into its variant for
+// the types of stack[0] and stack[1], if there is one. A variant checks
+// the types and rewrites it back when they change.
+void __Alu_quicken(alu_State *A, alu_Instruction *ins)
+{
+    if (__Alu_stackis(A, ALU_INTEGER))
+        ins->op = (ins->op == OP_SUMSTACK ? OP_SUMINT : OP_EVALINT);
+    else if (__Alu_stackis(A, ALU_NUMBER))
+        ins->op = (ins->op == OP_SUMSTACK ? OP_SUMNUM : OP_EVALNUM);
+    else if (__Alu_stackis(A, ALU_STRING))
+        ins->op = (ins->op == OP_SUMSTACK ? OP_SUMSTR : OP_EVALSTR);
+}
+
+// Executes the instruction set from `A->pc`.
+// Returns true if it stopped at the end of the code decoded so far, and
+// must be resumed once more code is fed.
+// A program proven by `Alu_verify` runs without the stack checks.
+_Bool Alu_execute(alu_State *A)
+{
+    alu_Instruction *ip = A->code + A->pc;
+    alu_Size pc = 0;
+    alu_Variable var;
+#if ALU_THREADED
+    static const void *checked[OP_COUNT] = VM_TABLE(CHECKED_);
+    static const void *fast[OP_COUNT] = VM_TABLE(TARGET_);
+    const void *const *targets = (A->verified ? fast : checked);
+    VM_DISPATCH();
+#else
+    const _Bool verified = A->verified;
+    for (;;)
+        switch (ip->op)
+        {
+#endif
+    VM_TARGET(OP_HALT)
+    VM_TARGET(OP_RET)
+        return false;
+    VM_TARGET(OP_YIELD)
+        A->pc = (alu_Size)(ip - A->code);
+        return true;
+    VM_TARGET(OP_JMP)
+    VM_TARGET(OP_JTR)
+    VM_TARGET(OP_JFA)
+    VM_TARGET(OP_JEM)
+    VM_TARGET(OP_JNEM)
+        pc = Alu_jump(A, (alu_Size)(ip - A->code));
+        if (__Alu_interrupted)
+            return false;
+        if (pc >= A->codelen)
+            return __Alu_jumpout(A, pc);
+        ip = &A->code[pc];
+        VM_DISPATCH();
+    VM_TARGET(OP_PUSHNUM)
+        Alu_pushnumber(A, ip->arg.number);
+        VM_NEXT();
+    VM_TARGET(OP_PUSHINT)
+        Alu_pushinteger(A, ip->arg.integer);
+        VM_NEXT();
+    VM_TARGET(OP_PUSHSTR)
+        Alu_pushconstant(A, ip->arg.string);
+        VM_NEXT();
+    VM_TARGET(OP_PUSHBOOL)
+        Alu_pushbool(A, ip->arg.byte);
+        VM_NEXT();
+    VM_TARGET(OP_PUSHDEF)
+        Alu_pushbuiltin(A, ip->arg.size);
+        VM_NEXT();
+    VM_CHECKED(OP_SUMSTACK)
+        __Alu_quicken(A, ip);
+        Alu_sumstack(A);
+        VM_NEXT();
+    VM_FAST(OP_SUMSTACK)
+        __Alu_quicken(A, ip);
+        __Alu_sumstack(A);
+        VM_NEXT();
+    VM_TARGET(OP_SUMNUM)
+        if (not __Alu_stackis(A, ALU_NUMBER))
+            VM_DEQUICKEN(OP_SUMSTACK);
+        __Alu_sumnum(A);
+        VM_NEXT();
+    VM_TARGET(OP_SUMINT)
+        if (not __Alu_stackis(A, ALU_INTEGER))
+            VM_DEQUICKEN(OP_SUMSTACK);
+        __Alu_sumint(A);
+        VM_NEXT();
+    VM_TARGET(OP_SUMSTR)
+        if (not __Alu_stackis(A, ALU_STRING))
+            VM_DEQUICKEN(OP_SUMSTACK);
+        __Alu_sumstr(A);
+        VM_NEXT();
+    VM_TARGET(OP_STACKCLOSE)
+        Alu_stackclose(A);
+        VM_NEXT();
+    VM_CHECKED(OP_EVAL)
+        __Alu_quicken(A, ip);
+        Alu_eval(A, ip->arg.byte);
+        VM_NEXT();
+    VM_FAST(OP_EVAL)
+        __Alu_quicken(A, ip);
+        __Alu_eval(A, ip->arg.byte);
+        VM_NEXT();
+    VM_TARGET(OP_EVALNUM)
+        if (not __Alu_stackis(A, ALU_NUMBER))
+            VM_DEQUICKEN(OP_EVAL);
+        __Alu_evalnum(A, ip->arg.byte);
+        VM_NEXT();
+    VM_TARGET(OP_EVALINT)
+        if (not __Alu_stackis(A, ALU_INTEGER))
+            VM_DEQUICKEN(OP_EVAL);
+        __Alu_evalint(A, ip->arg.byte);
+        VM_NEXT();
+    VM_TARGET(OP_EVALSTR)
+        if (not __Alu_stackis(A, ALU_STRING))
+            VM_DEQUICKEN(OP_EVAL);
+        __Alu_evalstr(A, ip->arg.byte);
+        VM_NEXT();
+    VM_CHECKED(OP_SUPER)
+        Alu_super(A);
+        VM_NEXT();
+    VM_FAST(OP_SUPER)
+        __Alu_super(A);
+        VM_NEXT();
+    VM_CHECKED(OP_CALL)
+        Alu_call(A);
+        if (__Alu_interrupted)
+            return false;
+        VM_NEXT();
+    VM_FAST(OP_CALL)
+        __Alu_call(A);
+        if (__Alu_interrupted)
+            return false;
+        VM_NEXT();
+    VM_CHECKED(OP_LOAD)
+        Alu_load(A, ip->arg.size);
+        VM_NEXT();
+    VM_FAST(OP_LOAD)
+        __Alu_load(A, ip->arg.size);
+        VM_NEXT();
+    VM_CHECKED(OP_UNLOAD)
+        Alu_unload(A, ip->arg.size);
+        VM_NEXT();
+    VM_FAST(OP_UNLOAD)
+        __Alu_unload(A, ip->arg.size);
+        VM_NEXT();
+    VM_CHECKED(OP_DEFUNLOAD)
+        Alu_defunload(A, ip->arg.size);
+        VM_NEXT();
+    VM_FAST(OP_DEFUNLOAD)
+        __Alu_defunload(A, ip->arg.size);
+        VM_NEXT();
+    VM_TARGET(OP_CALLDEF)
+        ((func0_t)DEF[ip->arg.size].f)(A);
+        if (__Alu_interrupted)
+            return false;
+        ip += 3;
+        VM_DISPATCH();
+    VM_TARGET(OP_ADDREG)
+        var = __Alu_numoperand(&ip[1]);
+        if ((var.type == ALU_INTEGER) and
+            (A->regs[ip[0].arg.size].type == ALU_INTEGER))
+        {
+            var = __Alu_addint(A->regs[ip[0].arg.size].as.integer,
+                               var.as.integer);
+            Alu_freevar(A, &A->regs[ip[3].arg.size]);
+            A->regs[ip[3].arg.size] = var;
+        }
+        else if (ALU_ISNUMBER(&A->regs[ip[0].arg.size]))
+        {
+            var = __Alu_addnumbers(&A->regs[ip[0].arg.size], &var);
+            Alu_freevar(A, &A->regs[ip[3].arg.size]);
+            A->regs[ip[3].arg.size] = var;
+        }
+        else
+        {
+            __Alu_unload(A, ip[0].arg.size);
+            Alu_push(A, var);
+            __Alu_sumstack(A);
+            __Alu_load(A, ip[3].arg.size);
+        }
+        ip += 4;
+        VM_DISPATCH();
+    VM_TARGET(OP_EVALJFA)
+    VM_TARGET(OP_EVALJTR)
+        pc = (__Alu_compare(A, ip->arg.byte) == (ip->op == OP_EVALJTR)
+                  ? ip[1].arg.target
+                  : (alu_Size)(ip - A->code) + 2);
+        if (__Alu_interrupted)
+            return false;
+        if (pc >= A->codelen)
+            return __Alu_jumpout(A, pc);
+        ip = &A->code[pc];
+        VM_DISPATCH();
+#if not ALU_THREADED
+        default:
+            return false;
+        }
+#endif
+}
+
+// Guess the stack capacity from the number of pushing instructions.
+alu_Size __Alu_stackhint(alu_State *A)
+{
+    alu_Size pushes = 0;
+    for (alu_Size pc = 0; pc < A->codelen; ++pc)
+        if (__Alu_ispure(A->code[pc].op) or (A->code[pc].op == OP_UNLOAD) or
+            (A->code[pc].op == OP_DEFUNLOAD))
+            ++pushes;
+    return (pushes < 256 ? pushes : 256);
+}
+
+// Reads the constant pool of a v2 program at `*ptr` and moves after it.
+_Bool __Alu_readconsts(alu_State *A, const alu_Byte **ptr,
+                       const alu_Byte *end, alu_Size count)
+{
+    alu_Size len = 0;
+    if (count > (alu_Size)(end - *ptr) / sizeof(alu_Size))
+        return false;
+    A->consts = (alu_StringObject **)Alu_arenalloc(
+        A, sizeof(alu_StringObject *) * (count ? count : 1));
+    if (A->consts == null)
+        return false;
+    for (A->nconsts = 0; A->nconsts < count; ++A->nconsts)
     {
-        op = ((alu_Byte *)instruction->data)[0];
-        if (op == OP_RET)
-            return;
-        debug(A, "Executes %02x\n", op);
-        if ((op >= OP_JMP) and (op <= OP_JNEM))
+        if ((size_t)(end - *ptr) < sizeof(alu_Size))
+            return false;
+        len = (alu_Size)bytesint(*ptr);
+        *ptr += sizeof(alu_Size);
+        if ((size_t)(end - *ptr) < len)
+            return false;
+        A->consts[A->nconsts] = Alu_intern(A, (const char *)*ptr, len);
+        if (A->consts[A->nconsts] == null)
+            return false;
+        *ptr += len;
+    }
+    return true;
+}
+
+// Decodes the chunks of a v2 program, whose table is at `table` and
+// whose code starts after it. Each chunk ends with its own `OP_HALT`,
+// and its jumps must land in it. The code ends with one more `OP_HALT`,
+// like a v1 program.
+_Bool __Alu_readchunks(alu_State *A, const alu_Byte *table,
+                       const alu_Byte *end)
+{
+    const alu_Byte *code = table + A->nchunks * 2 * sizeof(alu_Size);
+    alu_Size offset = 0, len = 0;
+
+    for (alu_Size n = 0; n < A->nchunks; ++n, table += 2 * sizeof(alu_Size))
+    {
+        offset = (alu_Size)bytesint(table);
+        len = (alu_Size)bytesint(table + sizeof(alu_Size));
+        if ((offset > (size_t)(end - code)) or
+            (len > (size_t)(end - code) - offset))
         {
-            Alu_jump(A, op, &instruction);
-            continue;
+            A->error = "Chunk out of the program";
+            raise(A, AERR_CREAD, false);
         }
-        __Alu_executeop(A, op, (alu_Byte *)instruction->data);
-        instruction = instruction->next;
+        A->chunks[n] = A->codelen;
+        A->chunkstart = A->codelen;
+        if (not Alu_feed(A, (const char *)code + offset, len))
+            return false;
+        ++A->codelen;
+    }
+    if (not __Alu_codereserve(A, A->codelen + 1))
+        return false;
+    A->code[A->codelen].op = OP_HALT;
+    return true;
+}
+
+// Decodes a v2 program of `len` bytes, header included.
+//
+// The sizes of the header are checked against the program size, then
+// used to allocate the code, the registers and the stack at once.
+_Bool __Alu_feedv2(alu_State *A, const alu_Byte *input, size_t len)
+{
+    const alu_Byte *ptr = input + ALU_HEADER_SIZE, *end = input + len;
+    alu_Size version = 0, flags = 0, nconsts = 0, depth = 0, nregs = 0;
+    alu_Size ninstr = 0;
+    _Bool fed = false;
+
+    if (len < ALU_HEADER_SIZE)
+    {
+        A->error = "Truncated header";
+        raise(A, AERR_CREAD, false);
+    }
+    version = (alu_Size)bytesint(input + 8);
+    flags = (alu_Size)((input[6] << 8) | input[7]);
+    if ((input[4] != ALU_FORMAT_V2) or (input[5] != 0) or
+        (flags & ~ALU_FLAG_VARINT) or (version / 100 != ALU_VER_MAJ) or
+        (version > ALU_VER_NUM))
+    {
+        A->error = "Unsupported bytecode version";
+        raise(A, AERR_CREAD, false);
+    }
+    nconsts = (alu_Size)bytesint(input + 12);
+    A->nchunks = (alu_Size)bytesint(input + 16);
+    depth = (alu_Size)bytesint(input + 20);
+    nregs = (alu_Size)bytesint(input + 24);
+    ninstr = (alu_Size)bytesint(input + 28);
+    if (not __Alu_readconsts(A, &ptr, end, nconsts) or (A->nchunks == 0) or
+        (A->nchunks > (size_t)(end - ptr) / (2 * sizeof(alu_Size))) or
+        (ninstr > (size_t)(end - ptr)) or (depth > ninstr) or
+        (nregs > ALU_MAX_REGISTER + 1))
+    {
+        A->error = (A->error ? A->error : "Invalid header");
+        raise(A, AERR_CREAD, false);
+    }
+    A->chunks = (alu_Size *)Alu_arenalloc(A, sizeof(alu_Size) * A->nchunks);
+    if ((A->chunks == null) or
+        not __Alu_codereserve(A, A->codelen + ninstr + A->nchunks + 1) or
+        not Alu_registerreserve(A, nregs) or
+        not Alu_stackreserve(A, depth))
+        return false;
+    A->varint = (flags & ALU_FLAG_VARINT);
+    fed = __Alu_readchunks(A, ptr, end);
+    A->consts = null;
+    A->varint = false;
+    A->chunkstart = 0;
+    A->pc = A->chunks[A->nchunks - 1];
+    return fed;
+}
+
+/// Decodes the program of `len` bytes at `input`, signature included.
+/// Both the v1 and the v2 bytecode are accepted.
+_Bool Alu_feedprogram(alu_State *A, const char *input, size_t len)
+{
+    const size_t siglen = sizeof(ALU_SIGNATURE) - 1;
+    if ((len < siglen) or (memcmp(input, ALU_SIGNATURE, siglen) != 0))
+    {
+        A->error = "Not an alu program";
+        raise(A, AERR_CREAD, false);
     }
+    if ((len > siglen) and ((alu_Byte)input[siglen] == ALU_FORMAT_MARK))
+        return __Alu_feedv2(A, (const alu_Byte *)input, len);
+    return Alu_feed(A, input + siglen, len - siglen);
 }
 
-// Start a program.
-void Alu_start(alu_State *A, alu_String input)
+// Runs the instructions fed to the state.
+void Alu_run(alu_State *A)
 {
-    input += strlen(ALU_SIGNATURE);
-    Alu_feed(A, input);
-    alu_Stack *inst = A->instructions;
-    unsigned int n = 0;
-    while (inst != null)
+    debug(A, "There is %d instructions\n", A->codelen);
+    __Alu_interrupted = 0;
+#if ALU_OPTIMIZE
+    if (Alu_optimize(A) < 0)
+        return;
+#else
+    if (not Alu_verify(A))
+        return;
+#endif
+    if (A->verified)
     {
-        inst = inst->next;
-        ++n;
+        if (not Alu_stackreserve(A, A->maxdepth))
+            return;
     }
-    debug(A, "There is %d instructions\n", n);
+    else if ((A->stack.cap == 0) and
+             not Alu_stackreserve(A, __Alu_stackhint(A)))
+        return;
     Alu_execute(A);
 }
 
+// Start a program of `len` bytes.
+void Alu_start(alu_State *A, const char *input, size_t len)
+{
+    if (Alu_feedprogram(A, input, len))
+        Alu_run(A);
+}
+
+// Checks the signature at the start of the stream buffer.
+// Returns the number of bytes it takes, 0 until the byte after it is
+// read, or -1.
+long __Alu_streamsignature(alu_State *A, const char *buffer, size_t have,
+                           _Bool more)
+{
+    const size_t siglen = sizeof(ALU_SIGNATURE) - 1;
+    if ((have <= siglen) and more)
+        return 0;
+    if ((have < siglen) or (memcmp(buffer, ALU_SIGNATURE, siglen) != 0))
+    {
+        A->error = "Not an alu program";
+        raise(A, AERR_CREAD, -1);
+    }
+    return (long)siglen;
+}
+
+// Start a program read from `fd` as it arrives, like from a pipe.
+//
+// The bytecode is read in chunks of `ALU_STREAM_CHUNK` bytes and each
+// chunk runs as soon as it is decoded. An instruction split between two
+// chunks waits for the next one, and the execution pauses at the end of
+// the decoded code or on a jump to code not read yet.
+// A v2 program is read whole before running, its sections are needed
+// to decode it.
+void Alu_startfd(alu_State *A, int fd)
+{
+    size_t cap = ALU_STREAM_CHUNK, have = 0;
+    char *buffer = malloc(cap), *grown = null;
+    _Bool more = true, halted = false, checked = false, running = true;
+    _Bool whole = false;
+    long used = 0, sig = 0;
+    ssize_t got = 0;
+
+    if (buffer == null)
+        raise(A, AERR_NOMEM, );
+    A->streaming = true;
+    __Alu_interrupted = 0;
+    while (more and not halted and running)
+    {
+        if ((have == cap) and ((grown = realloc(buffer, cap * 2)) != null))
+        {
+            buffer = grown;
+            cap *= 2;
+        }
+        else if (have == cap)
+        {
+            A->error = "Instruction too big";
+            break;
+        }
+        got = read(fd, buffer + have, cap - have);
+        if ((got < 0) and (errno == EINTR))
+            continue;
+        if (got < 0)
+        {
+            A->error = "Cannot read the program";
+            break;
+        }
+        have += got;
+        more = (got != 0);
+        if (not checked)
+        {
+            if ((sig = __Alu_streamsignature(A, buffer, have, more)) < 0)
+                break;
+            if (sig == 0)
+                continue;
+            checked = true;
+            whole = ((have > (size_t)sig) and
+                     ((alu_Byte)buffer[sig] == ALU_FORMAT_MARK));
+            if (not Alu_stackreserve(A, 16))
+                break;
+        }
+        if (whole and more)
+            continue;
+        if (whole)
+        {
+            A->streaming = false;
+            if (Alu_feedprogram(A, buffer, have))
+                Alu_run(A);
+            break;
+        }
+        used = __Alu_decode(A, buffer + sig, have - sig, &halted);
+        if (used < 0)
+            break;
+        have -= sig + used;
+        memmove(buffer, buffer + sig + used, have);
+        sig = 0;
+        if (not more and not halted and (have != 0))
+        {
+            A->error = "Truncated instruction";
+            break;
+        }
+        if (not more or halted)
+        {
+            A->streaming = false;
+            A->code[A->codelen].op = OP_HALT;
+        }
+        if (not A->streaming and ((A->pc > A->codelen) or
+                                  (A->farthest >= (long)A->codelen)))
+        {
+            A->error = "Jump out of the program";
+            break;
+        }
+        if (A->pc < A->codelen)
+            running = Alu_execute(A);
+        Alu_flush(A);
+    }
+    A->streaming = false;
+    free(buffer);
+}
+
 // Start a program by filename.
+//
+// Regular files are mapped and decoded in place, so the bytecode is
+// never copied and every process running it shares the same pages.
+// Other files, like pipes, are streamed with `Alu_startfd`.
 void Alu_startfile(alu_State *A, const alu_String filename)
 {
     int fd = open(filename, O_RDONLY);
-    char *buffer = null;
     struct stat st = {0};
+    char *buffer = null;
+    size_t len = 0;
+    _Bool fed = false;
+
     if (fd == -1)
-        raise(AERR_NOFIL, );
-    if (stat(filename, &st) == -1)
-        raise(errno, );
-    buffer = malloc(sizeof(char) * (st.st_size + 1));
-    if (buffer == null)
-        raise(AERR_NOMEM, );
-    memset(buffer, 0, st.st_size);
-    if (read(fd, buffer, st.st_size) == -1)
     {
-        remove(buffer);
-        raise(errno, );
+        A->error = "Cannot open the program";
+        raise(A, AERR_NOFIL, );
+    }
+    if (fstat(fd, &st) == -1)
+    {
+        close(fd);
+        raise(A, errno, );
+    }
+    if (S_ISREG(st.st_mode) and (st.st_size > 0))
+    {
+        len = (size_t)st.st_size;
+        buffer = mmap(null, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (buffer != MAP_FAILED)
+        {
+            close(fd);
+            madvise(buffer, len, MADV_SEQUENTIAL);
+            madvise(buffer, len, MADV_WILLNEED);
+            fed = Alu_feedprogram(A, buffer, len);
+            munmap(buffer, len);
+            if (fed)
+                Alu_run(A);
+            return;
+        }
     }
-    Alu_start(A, buffer);
-    remove(buffer);
+    Alu_startfd(A, fd);
+    close(fd);
 }
 
 /**
@@ -1140,18 +3496,19 @@ void Alu_startfile(alu_State *A, const alu_String filename)
 // Print stuff in stack, and empty it !
 void Alu_print(alu_State *A)
 {
-    while (A->stack != null)
+    while (A->stack.len != 0)
     {
-        Alu_tostring(A);
-        puts(((alu_Variable *)A->stack->data)->data);
+        Alu_writevar(A, ALU_STACK_SLOT(A, 0));
+        Alu_write(A, "\n", 1);
         Alu_popk(A);
     }
 }
 
 // Waits `ms` milliseconds.
-void Alu_wait(alu_State __attribute__((unused))*A, alu_Size ms)
+void Alu_wait(alu_State *A, alu_Size ms)
 {
     alu_Size a = 0, b = 0;
+    Alu_flush(A);
     a = clock();
     while (true)
     {
@@ -1161,43 +3518,49 @@ void Alu_wait(alu_State __attribute__((unused))*A, alu_Size ms)
     }
 }
 
-/// Execute the function in stack[0].
-void Alu_call(alu_State *A)
+// `Alu_call` without checking the stack length.
+void __Alu_call(alu_State *A)
 {
-    alu_Variable *var = null;
+    alu_Variable var = Alu_take(A);
     func0_t fptr = null;
-    if (A->stack == null)
-        raise(AERR_NOSTK, );
-    var = Alu_pop(A);
-    if (var->type == ALU_ABSTRACT)
+    if (var.type == ALU_ABSTRACT)
     {
-        fptr = var->data;
+        fptr = var.as.abstract;
         fptr(A);
+        return;
     }
-    else
-        raise(AERR_TYPES, )
+    Alu_freevar(A, &var);
+    raise(A, AERR_TYPES, )
+}
+
+/// Execute the function in stack[0].
+void Alu_call(alu_State *A)
+{
+    if (A->stack.len == 0)
+        raise(A, AERR_NOSTK, );
+    __Alu_call(A);
+}
+
+// `Alu_super` without checking the stack length.
+void __Alu_super(alu_State *A)
+{
+    alu_Variable super = *ALU_STACK_SLOT(A, A->stack.len - 1);
+    A->stack.head = (A->stack.head - 1) & (A->stack.cap - 1);
+    *ALU_STACK_SLOT(A, 0) = super;
 }
 
 // Set the head element to the top.
 void Alu_super(alu_State *A)
 {
-    alu_Stack *super = null, *degrade = null;
-    if (Stack_len(A->stack) < 2)
-        raise(AERR_STKLN,);
-    super = A->stack->top;
-    degrade = A->stack;
-    degrade->top = null;
-    super->top = super->previous;
-    super->previous->next = null;
-    super->previous = null;
-    super->next = degrade;
-    degrade->previous = super;
-    A->stack = super;
+    if (A->stack.len < 2)
+        raise(A, AERR_STKLN,);
+    __Alu_super(A);
 }
 
 /* Main */
 
-int main(void)
+// Runs the program given as argument, `-` reads it from stdin.
+int main(int argc, char **argv)
 {
     alu_State *A = Alu_newstate();
     // char input[] = {
@@ -1233,6 +3596,10 @@ int main(void)
     //     OP_CALL,
     //     OP_HALT,
     // };
-    Alu_startfile(A, "samples/file.alc");
+    alu_String filename = (argc > 1 ? argv[1] : "samples/file.alc");
+    if (strcmp(filename, "-") == 0)
+        Alu_startfd(A, STDIN_FILENO);
+    else
+        Alu_startfile(A, filename);
     return Alu_close(A);
 }
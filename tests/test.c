@@ -0,0 +1,610 @@
+/**
+ *
+ * Tests of the alu interpreter.
+ *
+ * The interpreter is included whole, so its internals can be reached,
+ * and built with the same flags as `build.ninja`.
+ *
+ */
+
+#define main __Alu_main
+#include "../alu.c"
+#undef main
+
+#define check(cond)                                          \
+    if (not (cond))                                          \
+    {                                                        \
+        fprintf(stderr, "| [FAIL] %s (%s:%d) %s\n",          \
+                __FUNCTION__, __FILE__, __LINE__, #cond);    \
+        ++failures;                                          \
+    }
+
+static int failures = 0;
+
+// Creates a state whose output is kept in memory.
+static alu_State *__Test_newstate(void)
+{
+    alu_State *A = Alu_newstate();
+    Alu_setoutput(A, -1);
+    return A;
+}
+
+// Checks that the state printed `output` and ends with `error`, null if
+// it must succeed, then closes it.
+static void __Test_expect(alu_State *A, const char *output, const char *error)
+{
+    size_t len = 0;
+    const char *out = Alu_output(A, &len);
+
+    check((len == strlen(output)) and
+          ((len == 0) or (memcmp(out, output, len) == 0)));
+    check((error == null) ? (A->error == null)
+                          : ((A->error != null) and
+                             (strcmp(A->error, error) == 0)));
+    A->error = null;
+    Alu_close(A);
+}
+
+// Runs the `len` bytes of `input` like `Alu_run`, through
+// `Alu_optimize` when `optimize` is set and only verified otherwise,
+// like with `ALU_NO_OPTIMIZE`.
+// Returns the number of instructions eliminated, -1 on error.
+static long __Test_run(alu_State *A, const char *input, size_t len,
+                       _Bool optimize)
+{
+    long eliminated = 0;
+
+    if (not Alu_feedprogram(A, input, len))
+        return -1;
+    eliminated = (optimize ? Alu_optimize(A) : (Alu_verify(A) ? 0 : -1));
+    if ((eliminated < 0) or
+        not Alu_stackreserve(A, (A->verified ? A->maxdepth
+                                             : __Alu_stackhint(A))))
+        return -1;
+    Alu_execute(A);
+    return eliminated;
+}
+
+// Checks that `input` prints `output` whether it is optimized or not,
+// and that the optimizer eliminates `eliminated` instructions.
+static void __Test_optimize(const char *input, size_t len,
+                            const char *output, long eliminated)
+{
+    alu_State *A = __Test_newstate();
+
+    check(__Test_run(A, input, len, false) == 0);
+    __Test_expect(A, output, null);
+    A = __Test_newstate();
+    check(__Test_run(A, input, len, true) == eliminated);
+    __Test_expect(A, output, null);
+}
+
+// Runs the `len` bytes of `input` streamed through a pipe.
+static void __Test_startpipe(alu_State *A, const char *input, size_t len)
+{
+    int fds[2];
+
+    if (pipe(fds) == -1)
+    {
+        A->error = "Cannot open a pipe";
+        return;
+    }
+    check(write(fds[1], input, len) == (ssize_t)len);
+    close(fds[1]);
+    Alu_startfd(A, fds[0]);
+    close(fds[0]);
+}
+
+/**
+ *
+ * @category Signals
+ *
+ */
+
+// An interrupt only stops the program running when it comes, the next
+// one runs whole, streamed or not.
+static void __Test_interruptreset(void)
+{
+    const char input[] = {
+        0x1b, 0xca, 0xca,
+        OP_PUSHBOOL,    1,
+        OP_JTR,         0, 0, 0, 1,
+        OP_PUSHSTR,     'a', '\0',
+        OP_PUSHSTR,     'b', '\0',
+        OP_PUSHDEF,     'p', 'r', 'i', 'n', 't', '\0',
+        OP_SUPER,
+        OP_CALL,
+        OP_HALT,
+    };
+    alu_State *A = __Test_newstate();
+
+    __Alu_sighandler(SIGINT);
+    Alu_start(A, input, sizeof(input));
+    __Test_expect(A, "b\n", null);
+    __Alu_sighandler(SIGINT);
+    A = __Test_newstate();
+    __Test_startpipe(A, input, sizeof(input));
+    __Test_expect(A, "b\n", null);
+}
+
+/**
+ *
+ * @category Streaming
+ *
+ */
+
+// A jump past the end is rejected whether the program is read whole or
+// streamed, even when it is never taken.
+static void __Test_streamjumpout(void)
+{
+    const char input[] = {
+        0x1b, 0xca, 0xca,
+        OP_PUSHBOOL,    0,
+        OP_JTR,         0, 0, 0, 100,
+        OP_PUSHSTR,     'a', '\0',
+        OP_PUSHDEF,     'p', 'r', 'i', 'n', 't', '\0',
+        OP_SUPER,
+        OP_CALL,
+        OP_HALT,
+    };
+    alu_State *A = __Test_newstate();
+
+    Alu_start(A, input, sizeof(input));
+    __Test_expect(A, "", "Jump out of the program");
+    A = __Test_newstate();
+    __Test_startpipe(A, input, sizeof(input));
+    __Test_expect(A, "", "Jump out of the program");
+}
+
+/**
+ *
+ * @category Sectioned bytecode
+ *
+ */
+
+// A jump of a v2 chunk must land in the same chunk.
+static void __Test_v2chunkjump(void)
+{
+    char input[] = {
+        0x1b, 0xca, 0xca, ALU_FORMAT_MARK, ALU_FORMAT_V2, 0, 0, 0,
+        0, 0, 0, ALU_VER_NUM,
+        0, 0, 0, 1,
+        0, 0, 0, 2,
+        0, 0, 0, 4,
+        0, 0, 0, 0,
+        0, 0, 0, 13,
+        0, 0, 0, 5, 'p', 'r', 'i', 'n', 't',
+        0, 0, 0, 0,     0, 0, 0, 10,
+        0, 0, 0, 10,    0, 0, 0, 19,
+        OP_PUSHBOOL,    1,
+        OP_PUSHDEF,     0, 0, 0, 0,
+        OP_SUPER,
+        OP_CALL,
+        OP_HALT,
+        OP_PUSHBOOL,    1,
+        OP_PUSHBOOL,    0,
+        OP_JMP,         0, 0, 0, 1,
+        OP_PUSHBOOL,    1,
+        OP_PUSHDEF,     0, 0, 0, 0,
+        OP_SUPER,
+        OP_CALL,
+        OP_HALT,
+    };
+    alu_State *A = __Test_newstate();
+
+    Alu_start(A, input, sizeof(input));
+    __Test_expect(A, "false\n", null);
+
+    // An offset of -6 jumps back to the start of the first chunk.
+    memset(&input[sizeof(input) - 14], 0xff, 3);
+    input[sizeof(input) - 11] = (char)0xfa;
+    A = __Test_newstate();
+    Alu_start(A, input, sizeof(input));
+    __Test_expect(A, "", "Jump out of the program");
+}
+
+/**
+ *
+ * @category Comparison
+ *
+ */
+
+// A NaN matches no flag of `OP_EVAL`, on either side.
+static void __Test_evalnan(void)
+{
+    char input[] = {
+        0x1b, 0xca, 0xca,
+        OP_PUSHNUM,     0x7f, 0xf8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_PUSHNUM,     0x3f, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_EVAL,        EVAL_EQUALS | EVAL_SMALLER | EVAL_GREATER,
+        OP_PUSHDEF,     'p', 'r', 'i', 'n', 't', '\0',
+        OP_SUPER,
+        OP_CALL,
+        OP_HALT,
+    };
+    alu_State *A = __Test_newstate();
+
+    Alu_start(A, input, sizeof(input));
+    __Test_expect(A, "false\n", null);
+
+    // 1 compared with a NaN.
+    memcpy(&input[4], "\x3f\xf0", 2);
+    memcpy(&input[13], "\x7f\xf8", 2);
+    A = __Test_newstate();
+    Alu_start(A, input, sizeof(input));
+    __Test_expect(A, "false\n", null);
+}
+
+// C functions are only compared for their equality, both order flags
+// mean "not equal" and a single one never holds.
+static void __Test_evalunordered(void)
+{
+    char input[] = {
+        0x1b, 0xca, 0xca,
+        OP_PUSHDEF,     'p', 'r', 'i', 'n', 't', '\0',
+        OP_PUSHDEF,     'w', 'a', 'i', 't', '\0',
+        OP_EVAL,        0,
+        OP_PUSHDEF,     'p', 'r', 'i', 'n', 't', '\0',
+        OP_SUPER,
+        OP_CALL,
+        OP_HALT,
+    };
+    const alu_Byte evals[] = {EVAL_SMALLER, EVAL_GREATER, EVAL_EQUALS,
+                              EVAL_SMALLER | EVAL_GREATER};
+    const char *outputs[] = {"false\n", "false\n", "false\n", "true\n"};
+    alu_State *A = null;
+
+    for (size_t n = 0; n < sizeof(evals); ++n)
+    {
+        input[17] = (char)evals[n];
+        A = __Test_newstate();
+        Alu_start(A, input, sizeof(input));
+        __Test_expect(A, outputs[n], null);
+    }
+}
+
+/**
+ *
+ * @category Integers
+ *
+ */
+
+// `Alu_getnumber` converts an integer result to a double.
+static void __Test_getinteger(void)
+{
+    const char input[] = {
+        0x1b, 0xca, 0xca,
+        OP_PUSHINT,     0, 0, 0, 2,
+        OP_PUSHINT,     0, 0, 0, 3,
+        OP_SUMSTACK,
+        OP_HALT,
+    };
+    alu_State *A = __Test_newstate();
+
+    Alu_start(A, input, sizeof(input));
+    check(A->stack.len == 1);
+    check(Alu_get(A, 0)->type == ALU_INTEGER);
+    check(Alu_getnumber(A, 0) == 5.0);
+    __Test_expect(A, "", null);
+}
+
+/**
+ *
+ * @category Optimizer
+ *
+ */
+
+// A loop with constant sums, a dead push before `OP_STACKCLOSE` and a
+// jump landing on an `OP_JMP`.
+static void __Test_optimizev1(void)
+{
+    const char input[] = {
+        0x1b, 0xca, 0xca,
+        OP_PUSHNUM,     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_LOAD,        0, 0, 0, 0,
+        OP_PUSHNUM,     0x3f, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_PUSHNUM,     0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_SUMSTACK,
+        OP_STACKCLOSE,
+        OP_PUSHSTR,     'a', '\0',
+        OP_PUSHSTR,     'b', '\0',
+        OP_SUMSTACK,
+        OP_PUSHDEF,     'p', 'r', 'i', 'n', 't', '\0',
+        OP_SUPER,
+        OP_CALL,
+        OP_UNLOAD,      0, 0, 0, 0,
+        OP_PUSHNUM,     0x3f, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_SUMSTACK,
+        OP_LOAD,        0, 0, 0, 0,
+        OP_UNLOAD,      0, 0, 0, 0,
+        OP_PUSHNUM,     0x40, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_EVAL,        EVAL_SMALLER,
+        OP_JTR,         0xff, 0xff, 0xff, 0xf0,
+        OP_PUSHBOOL,    1,
+        OP_JTR,         0, 0, 0, 1,
+        OP_PUSHSTR,     'x', '\0',
+        OP_JMP,         0, 0, 0, 1,
+        OP_PUSHSTR,     'y', '\0',
+        OP_UNLOAD,      0, 0, 0, 0,
+        OP_PUSHDEF,     'p', 'r', 'i', 'n', 't', '\0',
+        OP_SUPER,
+        OP_CALL,
+        OP_HALT,
+    };
+
+    __Test_optimize(input, sizeof(input), "ab\nab\nab\n3\n", 6);
+}
+
+// Writes the v2 program whose only chunk loops 3 times over `npairs`
+// dead `OP_PUSHBOOL`, `OP_STACKCLOSE` pairs, then prints the counter.
+// Returns its length.
+static size_t __Test_v2loop(char *buf, alu_Size npairs)
+{
+    const char header[] = {
+        0x1b, 0xca, 0xca, ALU_FORMAT_MARK, ALU_FORMAT_V2, 0, 0, 0,
+        0, 0, 0, ALU_VER_NUM,
+        0, 0, 0, 1,
+        0, 0, 0, 1,
+        0, 0, 0, 2,
+        0, 0, 0, 1,
+        0, 0, 0, 0,
+    };
+    const char start[] = {
+        OP_PUSHNUM,     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_LOAD,        0, 0, 0, 0,
+    };
+    const char pair[] = {
+        OP_PUSHBOOL,    1,
+        OP_STACKCLOSE,
+    };
+    const char end[] = {
+        OP_UNLOAD,      0, 0, 0, 0,
+        OP_PUSHNUM,     0x3f, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_SUMSTACK,
+        OP_LOAD,        0, 0, 0, 0,
+        OP_UNLOAD,      0, 0, 0, 0,
+        OP_PUSHNUM,     0x40, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_EVAL,        EVAL_SMALLER,
+        OP_JTR,         0, 0, 0, 0,
+        OP_UNLOAD,      0, 0, 0, 0,
+        OP_PUSHDEF,     0, 0, 0, 0,
+        OP_SUPER,
+        OP_CALL,
+        OP_HALT,
+    };
+    alu_Size ninstr = 2 + 2 * npairs + 12;
+    alu_Size codelen = sizeof(start) + npairs * sizeof(pair) + sizeof(end);
+    int32_t offset = -(int32_t)(2 * npairs + 6);
+    size_t len = 0;
+
+    memcpy(buf, header, sizeof(header));
+    len = sizeof(header);
+    for (int n = 0; n < 4; ++n)
+        buf[len - 4 + n] = (char)(ninstr >> (24 - 8 * n));
+    memcpy(buf + len, "\0\0\0\5print", 9);
+    len += 9;
+    memset(buf + len, 0, 8);
+    for (int n = 0; n < 4; ++n)
+        buf[len + 4 + n] = (char)(codelen >> (24 - 8 * n));
+    len += 8;
+    memcpy(buf + len, start, sizeof(start));
+    len += sizeof(start);
+    for (alu_Size n = 0; n < npairs; ++n, len += sizeof(pair))
+        memcpy(buf + len, pair, sizeof(pair));
+    memcpy(buf + len, end, sizeof(end));
+    for (int n = 0; n < 4; ++n)
+        buf[len + 37 + n] = (char)((uint32_t)offset >> (24 - 8 * n));
+    return len + sizeof(end);
+}
+
+// A v2 loop big enough for the code to need more than its first
+// allocation. The header counts the instructions without the `OP_HALT`
+// of the chunk, so the code is reserved to the exact size.
+static void __Test_optimizev2(void)
+{
+    char input[1024];
+    size_t len = __Test_v2loop(input, 200);
+
+    __Test_optimize(input, len, "3\n", 400);
+}
+
+// Returns true if the code of the state holds an `op` instruction.
+static _Bool __Test_hasop(alu_State *A, alu_Byte op)
+{
+    for (alu_Size pc = 0; pc < A->codelen; ++pc)
+        if (A->code[pc].op == op)
+            return true;
+    return false;
+}
+
+// Checks that `input` prints `output` with only the `fuse` flag set,
+// which fuses an `op`, and with fusion off.
+static void __Test_fuse(const char *input, size_t len, int fuse,
+                        alu_Byte op, const char *output)
+{
+    alu_State *A = __Test_newstate();
+
+    A->fuse = 0;
+    check(__Test_run(A, input, len, true) == 0);
+    check(not __Test_hasop(A, op));
+    __Test_expect(A, output, null);
+    A = __Test_newstate();
+    A->fuse = fuse;
+    check(__Test_run(A, input, len, true) == 0);
+    check(__Test_hasop(A, op));
+    __Test_expect(A, output, null);
+}
+
+static void __Test_fusecalldef(void)
+{
+    const char input[] = {
+        0x1b, 0xca, 0xca,
+        OP_PUSHBOOL,    1,
+        OP_PUSHDEF,     'p', 'r', 'i', 'n', 't', '\0',
+        OP_SUPER,
+        OP_CALL,
+        OP_HALT,
+    };
+
+    __Test_fuse(input, sizeof(input), ALU_FUSE_CALLDEF, OP_CALLDEF,
+                "true\n");
+}
+
+static void __Test_fuseaddreg(void)
+{
+    const char input[] = {
+        0x1b, 0xca, 0xca,
+        OP_PUSHNUM,     0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_LOAD,        0, 0, 0, 0,
+        OP_UNLOAD,      0, 0, 0, 0,
+        OP_PUSHNUM,     0x3f, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_SUMSTACK,
+        OP_LOAD,        0, 0, 0, 0,
+        OP_UNLOAD,      0, 0, 0, 0,
+        OP_PUSHDEF,     'p', 'r', 'i', 'n', 't', '\0',
+        OP_SUPER,
+        OP_CALL,
+        OP_HALT,
+    };
+
+    __Test_fuse(input, sizeof(input), ALU_FUSE_ADDREG, OP_ADDREG, "3\n");
+}
+
+// Compares 2 and 1, then jumps over the "no" with `jump`.
+static void __Test_fuseevaljump(alu_Byte jump, int fuse, alu_Byte op,
+                                const char *output)
+{
+    const char input[] = {
+        0x1b, 0xca, 0xca,
+        OP_PUSHNUM,     0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_PUSHNUM,     0x3f, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_EVAL,        EVAL_SMALLER,
+        jump,           0, 0, 0, 1,
+        OP_PUSHSTR,     'n', 'o', '\0',
+        OP_PUSHSTR,     'y', 'e', 's', '\0',
+        OP_PUSHDEF,     'p', 'r', 'i', 'n', 't', '\0',
+        OP_SUPER,
+        OP_CALL,
+        OP_HALT,
+    };
+
+    __Test_fuse(input, sizeof(input), fuse, op, output);
+}
+
+/**
+ *
+ * @category Quickening
+ *
+ */
+
+// A loop whose `OP_SUMSTACK` and `OP_EVAL` see integers, then numbers,
+// then strings, as register 1 takes the values of registers 2 and 3.
+// Each quickened variant must rewrite itself back when the types change.
+static void __Test_quickenchange(void)
+{
+    const char input[] = {
+        0x1b, 0xca, 0xca,
+        OP_PUSHINT,     0, 0, 0, 2,
+        OP_LOAD,        0, 0, 0, 1,
+        OP_PUSHNUM,     0x3f, 0xe0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_LOAD,        0, 0, 0, 2,
+        OP_PUSHSTR,     'a', 'b', '\0',
+        OP_LOAD,        0, 0, 0, 3,
+        OP_PUSHINT,     0, 0, 0, 0,
+        OP_LOAD,        0, 0, 0, 0,
+        OP_UNLOAD,      0, 0, 0, 1,
+        OP_UNLOAD,      0, 0, 0, 1,
+        OP_SUMSTACK,
+        OP_UNLOAD,      0, 0, 0, 1,
+        OP_EVAL,        EVAL_GREATER,
+        OP_PUSHDEF,     'p', 'r', 'i', 'n', 't', '\0',
+        OP_SUPER,
+        OP_CALL,
+        OP_UNLOAD,      0, 0, 0, 1,
+        OP_UNLOAD,      0, 0, 0, 1,
+        OP_SUMSTACK,
+        OP_PUSHDEF,     'p', 'r', 'i', 'n', 't', '\0',
+        OP_SUPER,
+        OP_CALL,
+        OP_UNLOAD,      0, 0, 0, 2,
+        OP_LOAD,        0, 0, 0, 1,
+        OP_UNLOAD,      0, 0, 0, 3,
+        OP_LOAD,        0, 0, 0, 2,
+        OP_UNLOAD,      0, 0, 0, 0,
+        OP_PUSHINT,     0, 0, 0, 1,
+        OP_SUMSTACK,
+        OP_LOAD,        0, 0, 0, 0,
+        OP_UNLOAD,      0, 0, 0, 0,
+        OP_PUSHINT,     0, 0, 0, 3,
+        OP_EVAL,        EVAL_SMALLER,
+        OP_JTR,         0xff, 0xff, 0xff, 0xe8,
+        OP_HALT,
+    };
+    alu_State *A = __Test_newstate();
+
+    Alu_start(A, input, sizeof(input));
+    check(__Test_hasop(A, OP_SUMSTR) and __Test_hasop(A, OP_EVALSTR));
+    __Test_expect(A, "true\n4\ntrue\n1\ntrue\nabab\n", null);
+}
+
+/**
+ *
+ * @category Verifier
+ *
+ */
+
+// A block reached with depth 0 from a jump and 2 from another path only
+// underflows on one of them, so it is checked at runtime.
+static void __Test_verifyconverge(void)
+{
+    const char input[] = {
+        0x1b, 0xca, 0xca,
+        OP_PUSHBOOL,    1,
+        OP_JTR,         0, 0, 0, 5,
+        OP_PUSHBOOL,    0,
+        OP_PUSHNUM,     0x3f, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_PUSHNUM,     0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        OP_JMP,         0, 0, 0, 1,
+        OP_PUSHSTR,     'x', '\0',
+        OP_SUMSTACK,
+        OP_PUSHDEF,     'p', 'r', 'i', 'n', 't', '\0',
+        OP_SUPER,
+        OP_CALL,
+        OP_HALT,
+    };
+    char copy[sizeof(input)];
+    alu_State *A = __Test_newstate();
+
+    check(Alu_feedprogram(A, input, sizeof(input)));
+    check(Alu_verify(A));
+    check(not A->verified);
+    __Test_expect(A, "", null);
+
+    // The same program, with the first jump not taken.
+    memcpy(copy, input, sizeof(input));
+    copy[4] = 0;
+    A = __Test_newstate();
+    Alu_start(A, copy, sizeof(copy));
+    __Test_expect(A, "3\n", null);
+}
+
+int main(void)
+{
+    __Test_interruptreset();
+    __Test_streamjumpout();
+    __Test_v2chunkjump();
+    __Test_evalnan();
+    __Test_evalunordered();
+    __Test_getinteger();
+    __Test_optimizev1();
+    __Test_optimizev2();
+    __Test_fusecalldef();
+    __Test_fuseaddreg();
+    __Test_fuseevaljump(OP_JFA, ALU_FUSE_EVALJFA, OP_EVALJFA, "yes\n");
+    __Test_fuseevaljump(OP_JTR, ALU_FUSE_EVALJTR, OP_EVALJTR, "no\nyes\n");
+    __Test_quickenchange();
+    __Test_verifyconverge();
+    if (failures != 0)
+        fprintf(stderr, "| [FAIL] %d checks failed\n", failures);
+    return (failures != 0);
+}